@@ -0,0 +1,390 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// CPU-side asset data, as produced by Assimp/stb_image or read from the cache
+struct ImageData {
+    std::string path;  // Texture::path for models, as LearnOpenGL stores it
+    std::string type;
+    int width = 0, height = 0, channels = 0;
+    std::vector<std::vector<unsigned char>> levels;  // Full mip chain, level 0 first; empty if loading failed
+};
+
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<int> images;  // Indices into AssetData::images
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+};
+
+struct AssetData {
+    std::vector<MeshData> meshes;
+    std::vector<std::vector<MeshData>> lods;  // Coarser versions of meshes, LOD 1 first
+    std::vector<ImageData> images;
+    std::vector<std::string> dependencies;  // Files whose contents key the cache entry
+};
+
+// Read-only view of a whole file: mmap where available, a plain read otherwise
+class MappedFile {
+public:
+    ~MappedFile() { Close(); }
+
+    bool Open(const std::string& path)
+    {
+#ifdef _WIN32
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) return false;
+        fseek(f, 0, SEEK_END);
+        long length = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        buffer.resize(length > 0 ? (size_t)length : 0);
+        bool ok = length >= 0 && fread(buffer.data(), 1, buffer.size(), f) == buffer.size();
+        fclose(f);
+        data = buffer.data();
+        size = buffer.size();
+        return ok;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) { close(fd); return false; }
+        size = (size_t)st.st_size;
+        if (size > 0) {
+            void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) { close(fd); size = 0; return false; }
+            data = (const unsigned char*)p;
+            mapped = true;
+        }
+        close(fd);
+        return true;
+#endif
+    }
+
+    void Close()
+    {
+#ifndef _WIN32
+        if (mapped) munmap((void*)data, size);
+#endif
+        mapped = false;
+        data = NULL;
+        size = 0;
+        buffer.clear();
+    }
+
+    const unsigned char* data = NULL;
+    size_t size = 0;
+
+private:
+    bool mapped = false;
+    std::vector<unsigned char> buffer;
+};
+
+// Baked asset cache: one binary file next to each source (name + ".bin")
+// holding vertex/index buffers, bounds and full mip chains, so a warm start
+// skips Assimp, JPEG decoding and mip generation. An entry is only used while
+// every dependency (source, .mtl, textures) is unchanged: a dependency whose
+// size and modification time match what was stored is taken as is, and one
+// with only a new time is hashed (FNV-1a) and compared, so a warm start
+// doesn't read the sources. Entries whose contents don't add up (indices past
+// their mesh, level sizes off, bytes left over) count as stale too.
+//
+// Layout (little-endian): "CACH", u32 version, u32 sizeof(Vertex), u32 flags,
+// u32 dependency count, then per dependency { string path, u64 size,
+// i64 mtime (ns), u64 hash },
+// u32 image count, per image { string path, string type, i32 width, height,
+// channels, u32 levels, per level { u32 bytes, bytes } }, u32 mesh count,
+// per mesh { vec3 min, vec3 max, u32 image count, i32 images[],
+// u32 vertex count, Vertex[], u32 index count, u32[] }, u32 LOD count, per
+// LOD { u32 mesh count, meshes as above }. Strings are u32 length + bytes.
+class AssetCache {
+public:
+    static const uint32_t VERSION = 4;  // 2: meshes are stored optimised, 3: LOD chains, 4: dependency size and time
+
+    static std::string PathFor(const std::string& source) { return source + ".bin"; }
+
+    static bool HashFile(const std::string& path, uint64_t& hash)
+    {
+        MappedFile file;
+        if (!file.Open(path)) return false;
+        hash = 1469598103934665603ull;
+        for (size_t i = 0; i < file.size; i++) {
+            hash ^= file.data[i];
+            hash *= 1099511628211ull;
+        }
+        return true;
+    }
+
+    // Size and modification time in nanoseconds (seconds where that's all
+    // the platform keeps)
+    static bool StatFile(const std::string& path, uint64_t& size, int64_t& mtime)
+    {
+#ifdef _WIN32
+        struct __stat64 st;
+        if (_stat64(path.c_str(), &st) != 0) return false;
+        mtime = (int64_t)st.st_mtime * 1000000000;
+#else
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return false;
+#if defined(__APPLE__)
+        mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+        mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+        size = (uint64_t)st.st_size;
+        return true;
+    }
+
+    // .mtl files named by an .obj's mtllib lines, relative to its directory
+    static std::vector<std::string> MaterialLibraries(const std::string& objPath)
+    {
+        std::vector<std::string> libs;
+        MappedFile file;
+        if (!file.Open(objPath)) return libs;
+        std::string directory = objPath.substr(0, objPath.find_last_of('/'));
+        const char* p = (const char*)file.data;
+        const char* end = p + file.size;
+        while (p < end) {
+            const char* eol = (const char*)memchr(p, '\n', end - p);
+            if (!eol) eol = end;
+            if (eol - p > 7 && strncmp(p, "mtllib ", 7) == 0) {
+                std::string name(p + 7, eol);
+                while (!name.empty() && (name.back() == '\r' || name.back() == ' ')) name.pop_back();
+                libs.push_back(directory + '/' + name);
+            }
+            p = eol + 1;
+        }
+        return libs;
+    }
+
+    // Fills out from the cache entry for source; false if it is missing, stale
+    // or was written with a different layout
+    static bool Load(const std::string& source, uint32_t flags, AssetData& out)
+    {
+        MappedFile file;
+        if (!file.Open(PathFor(source))) return false;
+        Reader r = { file.data, file.data + file.size };
+
+        char magic[4];
+        uint32_t version = 0, vertexSize = 0, storedFlags = 0, count = 0;
+        if (!r.Bytes(magic, 4) || memcmp(magic, "CACH", 4) != 0) return false;
+        if (!r.U32(version) || version != VERSION) return false;
+        if (!r.U32(vertexSize) || vertexSize != sizeof(Vertex)) return false;
+        if (!r.U32(storedFlags) || storedFlags != flags) return false;
+
+        AssetData data;
+        if (!r.U32(count)) return false;
+        for (uint32_t i = 0; i < count; i++) {
+            std::string path;
+            uint64_t storedSize = 0, storedHash = 0, size = 0, hash = 0;
+            int64_t storedTime = 0, time = 0;
+            if (!r.String(path) || !r.Bytes(&storedSize, 8) || !r.Bytes(&storedTime, 8) || !r.Bytes(&storedHash, 8)) return false;
+            if (!StatFile(path, size, time) || size != storedSize) return false;
+            if (time != storedTime && (!HashFile(path, hash) || hash != storedHash)) return false;
+            data.dependencies.push_back(path);
+        }
+
+        if (!r.U32(count)) return false;
+        data.images.resize(count);
+        for (ImageData& image : data.images) {
+            uint32_t levels = 0;
+            if (!r.String(image.path) || !r.String(image.type)) return false;
+            if (!r.Bytes(&image.width, 4) || !r.Bytes(&image.height, 4) || !r.Bytes(&image.channels, 4)) return false;
+            if (!r.U32(levels) || levels > 32) return false;
+            if (image.width < 0 || image.height < 0 || image.channels < 0 || image.channels > 4) return false;
+            image.levels.resize(levels);
+            int w = image.width, h = image.height;
+            for (std::vector<unsigned char>& level : image.levels) {
+                uint32_t bytes = 0;
+                if (!r.U32(bytes) || bytes != (uint64_t)w * h * image.channels || !r.Array(level, bytes)) return false;
+                w = std::max(1, w / 2);
+                h = std::max(1, h / 2);
+            }
+        }
+
+        if (!ReadMeshes(r, data.meshes, (int)data.images.size())) return false;
+        if (!r.U32(count)) return false;
+        data.lods.resize(count);
+        for (std::vector<MeshData>& lod : data.lods)
+            if (!ReadMeshes(r, lod, (int)data.images.size())) return false;
+        if (r.p != r.end) return false;  // The layout accounts for every byte
+        out = std::move(data);
+        return true;
+    }
+
+    static bool Save(const std::string& source, uint32_t flags, const AssetData& data)
+    {
+        std::vector<unsigned char> buf;
+        Writer w = { buf };
+        w.Bytes("CACH", 4);
+        w.U32(VERSION);
+        w.U32((uint32_t)sizeof(Vertex));
+        w.U32(flags);
+
+        w.U32((uint32_t)data.dependencies.size());
+        for (const std::string& path : data.dependencies) {
+            uint64_t size = 0, hash = 0;
+            int64_t time = 0;
+            if (!StatFile(path, size, time) || !HashFile(path, hash)) return false;
+            w.String(path);
+            w.Bytes(&size, 8);
+            w.Bytes(&time, 8);
+            w.Bytes(&hash, 8);
+        }
+
+        w.U32((uint32_t)data.images.size());
+        for (const ImageData& image : data.images) {
+            w.String(image.path);
+            w.String(image.type);
+            w.Bytes(&image.width, 4);
+            w.Bytes(&image.height, 4);
+            w.Bytes(&image.channels, 4);
+            w.U32((uint32_t)image.levels.size());
+            for (const std::vector<unsigned char>& level : image.levels) {
+                w.U32((uint32_t)level.size());
+                w.Bytes(level.data(), level.size());
+            }
+        }
+
+        WriteMeshes(w, data.meshes);
+        w.U32((uint32_t)data.lods.size());
+        for (const std::vector<MeshData>& lod : data.lods)
+            WriteMeshes(w, lod);
+
+        // Write to a temporary name first so a crash never leaves a torn entry
+        std::string path = PathFor(source);
+        std::string tmp = path + ".tmp";
+        FILE* f = fopen(tmp.c_str(), "wb");
+        if (!f) return false;
+        bool ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+        ok = fclose(f) == 0 && ok;
+        remove(path.c_str());
+        return ok && rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    // Box-filtered mip chain from levels[0] down to 1x1, standing in for
+    // glGenerateMipmap
+    static void BuildMips(ImageData& image)
+    {
+        if (image.levels.empty()) return;
+        image.levels.resize(1);
+        int w = image.width, h = image.height, c = image.channels;
+        while (w > 1 || h > 1) {
+            int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+            const std::vector<unsigned char>& src = image.levels.back();
+            std::vector<unsigned char> dst((size_t)nw * nh * c);
+            for (int y = 0; y < nh; y++) {
+                int y0 = std::min(y * 2, h - 1), y1 = std::min(y * 2 + 1, h - 1);
+                for (int x = 0; x < nw; x++) {
+                    int x0 = std::min(x * 2, w - 1), x1 = std::min(x * 2 + 1, w - 1);
+                    for (int k = 0; k < c; k++) {
+                        int sum = src[((size_t)y0 * w + x0) * c + k] + src[((size_t)y0 * w + x1) * c + k]
+                            + src[((size_t)y1 * w + x0) * c + k] + src[((size_t)y1 * w + x1) * c + k];
+                        dst[((size_t)y * nw + x) * c + k] = (unsigned char)((sum + 2) / 4);
+                    }
+                }
+            }
+            image.levels.push_back(std::move(dst));
+            w = nw;
+            h = nh;
+        }
+    }
+
+private:
+    struct Reader {
+        const unsigned char* p;
+        const unsigned char* end;
+
+        bool Bytes(void* out, size_t n)
+        {
+            if ((size_t)(end - p) < n) return false;
+            memcpy(out, p, n);
+            p += n;
+            return true;
+        }
+        bool U32(uint32_t& v) { return Bytes(&v, 4); }
+        bool String(std::string& s)
+        {
+            uint32_t n = 0;
+            if (!U32(n) || (size_t)(end - p) < n) return false;
+            s.assign((const char*)p, n);
+            p += n;
+            return true;
+        }
+        template <typename T>
+        bool Array(std::vector<T>& v, uint32_t n)
+        {
+            if ((size_t)(end - p) / sizeof(T) < n) return false;
+            v.resize(n);
+            return Bytes(v.data(), (size_t)n * sizeof(T));
+        }
+    };
+
+    struct Writer {
+        std::vector<unsigned char>& out;
+
+        void Bytes(const void* data, size_t n)
+        {
+            const unsigned char* b = (const unsigned char*)data;
+            out.insert(out.end(), b, b + n);
+        }
+        void U32(uint32_t v) { Bytes(&v, 4); }
+        void String(const std::string& s)
+        {
+            U32((uint32_t)s.size());
+            Bytes(s.data(), s.size());
+        }
+    };
+
+    static bool ReadMeshes(Reader& r, std::vector<MeshData>& meshes, int imageCount)
+    {
+        uint32_t count = 0;
+        if (!r.U32(count)) return false;
+        meshes.resize(count);
+        for (MeshData& mesh : meshes) {
+            uint32_t n = 0;
+            if (!r.Bytes(&mesh.boundsMin, sizeof(glm::vec3)) || !r.Bytes(&mesh.boundsMax, sizeof(glm::vec3))) return false;
+            if (!r.U32(n) || !r.Array(mesh.images, n)) return false;
+            for (int image : mesh.images)
+                if (image < 0 || image >= imageCount) return false;
+            if (!r.U32(n) || !r.Array(mesh.vertices, n)) return false;
+            if (!r.U32(n) || !r.Array(mesh.indices, n)) return false;
+            for (unsigned int index : mesh.indices)
+                if (index >= mesh.vertices.size()) return false;
+        }
+        return true;
+    }
+
+    static void WriteMeshes(Writer& w, const std::vector<MeshData>& meshes)
+    {
+        w.U32((uint32_t)meshes.size());
+        for (const MeshData& mesh : meshes) {
+            w.Bytes(&mesh.boundsMin, sizeof(glm::vec3));
+            w.Bytes(&mesh.boundsMax, sizeof(glm::vec3));
+            w.U32((uint32_t)mesh.images.size());
+            w.Bytes(mesh.images.data(), mesh.images.size() * sizeof(int));
+            w.U32((uint32_t)mesh.vertices.size());
+            w.Bytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            w.U32((uint32_t)mesh.indices.size());
+            w.Bytes(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,390 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader_m.h>
+#include <stb_image.h>
+
+#include "asset_cache.h"
+#include "mesh_optimizer.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Meshes and Draw() of LearnOpenGL's Model, filled in by AssetLoader instead
+// of a blocking constructor
+class LoadedModel {
+public:
+    std::vector<Mesh> meshes;
+    std::vector<std::vector<Mesh>> lods;  // Simplified meshes, LOD 1 first; may be empty
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);  // Model space, over all meshes
+
+    int LodCount() const { return 1 + (int)lods.size(); }
+    const std::vector<Mesh>& Lod(int level) const { return level == 0 ? meshes : lods[level - 1]; }
+
+    void Draw(Shader& shader)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(shader);
+    }
+};
+
+// Loads models and textures in parallel. Workers do everything that doesn't
+// need GL (Assimp import, stb_image decode); Upload() then creates the GL
+// objects on the GL thread a few assets at a time, so a loading screen can
+// keep drawing while the rest is still being parsed.
+//
+// Models go through MeshOptimizer after import. With a cache enabled,
+// workers read baked entries (see AssetCache) instead and write one after
+// every cache miss.
+class AssetLoader {
+public:
+    ~AssetLoader() { Join(); }
+
+    bool UseCache = true;
+
+    // Queue before Start(); the target is written when the asset is uploaded
+    void QueueModel(LoadedModel** target, const std::string& path)
+    {
+        Job job;
+        job.path = path;
+        job.model = target;
+        jobs.push_back(job);
+    }
+
+    // flip matches loadTexture()'s stbi_set_flip_vertically_on_load(true); the
+    // flip is done here since stb's flag is global and workers share it
+    void QueueTexture(unsigned int* target, const std::string& path, bool flip = true)
+    {
+        Job job;
+        job.path = path;
+        job.texture = target;
+        job.flip = flip;
+        jobs.push_back(job);
+    }
+
+    void Start(unsigned int threads = 0)
+    {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min<unsigned int>(threads, (unsigned int)jobs.size());
+        start = std::chrono::steady_clock::now();
+        workerCount = threads;
+        for (unsigned int i = 0; i < threads; i++)
+            workers.push_back(std::thread(&AssetLoader::Work, this));
+    }
+
+    // Uploads finished assets until budgetMs is spent; GL thread only.
+    // Returns the number of assets uploaded.
+    int Upload(double budgetMs)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        int count = 0;
+        while (true) {
+            int index;
+            {
+                std::lock_guard<std::mutex> lock(readyMutex);
+                if (ready.empty()) break;
+                index = ready.front();
+                ready.erase(ready.begin());
+            }
+            Job& job = jobs[index];
+            auto t0 = std::chrono::steady_clock::now();
+            if (job.model) UploadModel(job);
+            else UploadTexture(job);
+            job.uploadMs = MsSince(t0);
+            uploaded++;
+            count++;
+            if (MsSince(begin) >= budgetMs) break;
+        }
+        if (Done()) {
+            Join();
+            if (totalMs == 0.0) totalMs = MsSince(start);
+        }
+        return count;
+    }
+
+    // Runs every job to completion without uploading anything, filling the
+    // cache; needs no GL context
+    void Bake()
+    {
+        Start();
+        Join();
+        for (const Job& job : jobs)
+            printf("%-60s %s %8.1f ms\n", job.path.c_str(), job.cached ? "up to date" : "baked     ", job.decodeMs);
+    }
+
+    int Total() const { return (int)jobs.size(); }
+    int Uploaded() const { return uploaded; }
+    bool Done() const { return uploaded == (int)jobs.size(); }
+
+    void PrintTimings() const
+    {
+        double decodeSum = 0.0, uploadSum = 0.0;
+        printf("%-60s %10s %10s\n", "asset", "load ms", "upload ms");
+        for (const Job& job : jobs) {
+            printf("%-60s %10.1f %10.1f%s\n", job.path.c_str(), job.decodeMs, job.uploadMs, job.cached ? " (cached)" : "");
+            decodeSum += job.decodeMs;
+            uploadSum += job.uploadMs;
+        }
+        printf("%d assets in %.1f ms on %d threads (%.1f ms load + %.1f ms upload if sequential)\n",
+            Total(), totalMs, (int)workerCount, decodeSum, uploadSum);
+    }
+
+private:
+    struct Job {
+        std::string path;
+        LoadedModel** model = NULL;
+        unsigned int* texture = NULL;
+        bool flip = false;
+        bool cached = false;  // Came from the cache rather than the source files
+        AssetData data;
+        double decodeMs = 0.0, uploadMs = 0.0;
+    };
+
+    std::vector<Job> jobs;  // Fixed once Start() is called
+    std::atomic<int> nextJob{ 0 };
+    std::vector<std::thread> workers;
+    size_t workerCount = 0;
+    std::mutex readyMutex;
+    std::vector<int> ready;  // Decoded jobs waiting for Upload()
+    int uploaded = 0;
+    std::map<std::string, unsigned int> textureIds;  // Shared across models, like textures_loaded
+    std::chrono::steady_clock::time_point start;
+    double totalMs = 0.0;
+
+    static double MsSince(std::chrono::steady_clock::time_point t)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+    }
+
+    void Join()
+    {
+        for (std::thread& t : workers) t.join();
+        workers.clear();
+    }
+
+    void Work()
+    {
+        int index;
+        while ((index = nextJob++) < (int)jobs.size()) {
+            Job& job = jobs[index];
+            auto t0 = std::chrono::steady_clock::now();
+            uint32_t flags = job.flip ? 1 : 0;
+            job.cached = UseCache && AssetCache::Load(job.path, flags, job.data);
+            if (!job.cached) {
+                if (job.model) {
+                    ParseModel(job);
+                    MeshOptimizer::Optimize(job.data);
+                }
+                else {
+                    ImageData image;
+                    image.path = job.path;
+                    Decode(image, job.path, job.flip);
+                    job.data.images.push_back(std::move(image));
+                    job.data.dependencies.push_back(job.path);
+                }
+                if (UseCache && !AssetCache::Save(job.path, flags, job.data))
+                    std::cout << "Failed to write asset cache: " << AssetCache::PathFor(job.path) << std::endl;
+            }
+            job.decodeMs = MsSince(t0);
+
+            std::lock_guard<std::mutex> lock(readyMutex);
+            ready.push_back(index);
+        }
+    }
+
+    // Decodes level 0 (flipped if asked) and builds the mip chain from it
+    static void Decode(ImageData& image, const std::string& file, bool flip)
+    {
+        unsigned char* pixels = stbi_load(file.c_str(), &image.width, &image.height, &image.channels, 0);
+        if (!pixels) return;
+        size_t row = (size_t)image.width * image.channels;
+        std::vector<unsigned char> level(row * image.height);
+        for (int y = 0; y < image.height; y++) {
+            int src = flip ? image.height - 1 - y : y;
+            std::copy(pixels + src * row, pixels + (src + 1) * row, level.begin() + y * row);
+        }
+        stbi_image_free(pixels);
+        image.levels.push_back(std::move(level));
+        AssetCache::BuildMips(image);
+    }
+
+    // Same import flags and vertex/texture layout as LearnOpenGL's Model::loadModel
+    void ParseModel(Job& job)
+    {
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(job.path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            return;
+        }
+        std::string directory = job.path.substr(0, job.path.find_last_of('/'));
+        ParseNode(job, scene->mRootNode, scene, directory);
+
+        job.data.dependencies.push_back(job.path);
+        for (const std::string& lib : AssetCache::MaterialLibraries(job.path))
+            job.data.dependencies.push_back(lib);
+        for (const ImageData& image : job.data.images)
+            job.data.dependencies.push_back(directory + '/' + image.path);
+    }
+
+    void ParseNode(Job& job, aiNode* node, const aiScene* scene, const std::string& directory)
+    {
+        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+            ParseMesh(job, scene->mMeshes[node->mMeshes[i]], scene, directory);
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
+            ParseNode(job, node->mChildren[i], scene, directory);
+    }
+
+    void ParseMesh(Job& job, aiMesh* mesh, const aiScene* scene, const std::string& directory)
+    {
+        MeshData data;
+        data.vertices.reserve(mesh->mNumVertices);
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+            Vertex vertex = {};
+            vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+            if (mesh->HasNormals())
+                vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+            if (mesh->mTextureCoords[0]) {
+                vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+                vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+                vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+            }
+            data.vertices.push_back(vertex);
+            data.boundsMin = i == 0 ? vertex.Position : glm::min(data.boundsMin, vertex.Position);
+            data.boundsMax = i == 0 ? vertex.Position : glm::max(data.boundsMax, vertex.Position);
+        }
+        data.indices.reserve(mesh->mNumFaces * 3);
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+            for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++)
+                data.indices.push_back(mesh->mFaces[i].mIndices[j]);
+
+        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        ParseMaterial(job, data, material, aiTextureType_DIFFUSE, "texture_diffuse", directory);
+        ParseMaterial(job, data, material, aiTextureType_SPECULAR, "texture_specular", directory);
+        ParseMaterial(job, data, material, aiTextureType_HEIGHT, "texture_normal", directory);
+        ParseMaterial(job, data, material, aiTextureType_AMBIENT, "texture_height", directory);
+        job.data.meshes.push_back(std::move(data));
+    }
+
+    // Each texture file is decoded once per model; meshes refer to it by index
+    void ParseMaterial(Job& job, MeshData& data, aiMaterial* material, aiTextureType type,
+        const std::string& typeName, const std::string& directory)
+    {
+        for (unsigned int i = 0; i < material->GetTextureCount(type); i++) {
+            aiString str;
+            material->GetTexture(type, i, &str);
+            std::vector<ImageData>& images = job.data.images;
+            int found = -1;
+            for (size_t j = 0; j < images.size(); j++)
+                if (images[j].path == str.C_Str()) found = (int)j;
+            if (found < 0) {
+                ImageData image;
+                image.path = str.C_Str();
+                image.type = typeName;
+                Decode(image, directory + '/' + image.path, false);
+                if (image.levels.empty()) std::cout << "Texture failed to load at path: " << image.path << std::endl;
+                found = (int)images.size();
+                images.push_back(std::move(image));
+            }
+            data.images.push_back(found);
+        }
+    }
+
+    // Same sampling state as TextureFromFile / loadTexture; the mip chain
+    // comes prebuilt instead of from glGenerateMipmap
+    unsigned int UploadImage(ImageData& image)
+    {
+        unsigned int id;
+        glGenTextures(1, &id);
+        if (!image.levels.empty()) {
+            GLenum format = GL_RGB;
+            if (image.channels == 1) format = GL_RED;
+            else if (image.channels == 4) format = GL_RGBA;
+            glBindTexture(GL_TEXTURE_2D, id);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // Rows of odd-width RGB images aren't 4-byte aligned
+            int w = image.width, h = image.height;
+            for (size_t level = 0; level < image.levels.size(); level++) {
+                glTexImage2D(GL_TEXTURE_2D, (GLint)level, format, w, h, 0, format, GL_UNSIGNED_BYTE, image.levels[level].data());
+                w = std::max(1, w / 2);
+                h = std::max(1, h / 2);
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        image.levels.clear();
+        image.levels.shrink_to_fit();
+        return id;
+    }
+
+    void UploadTexture(Job& job)
+    {
+        ImageData& image = job.data.images[0];
+        if (image.levels.empty()) std::cout << "Failed to load texture: " << job.path << "\n";
+        *job.texture = UploadImage(image);
+    }
+
+    void UploadModel(Job& job)
+    {
+        std::string directory = job.path.substr(0, job.path.find_last_of('/'));
+        std::vector<ImageData>& images = job.data.images;
+        std::vector<unsigned int> ids(images.size());
+        for (size_t i = 0; i < images.size(); i++) {
+            std::string key = directory + '/' + images[i].path;
+            auto it = textureIds.find(key);
+            if (it != textureIds.end()) ids[i] = it->second;
+            else ids[i] = textureIds[key] = UploadImage(images[i]);
+        }
+
+        LoadedModel* model = new LoadedModel();
+        for (size_t m = 0; m < job.data.meshes.size(); m++) {
+            const MeshData& data = job.data.meshes[m];
+            model->boundsMin = m == 0 ? data.boundsMin : glm::min(model->boundsMin, data.boundsMin);
+            model->boundsMax = m == 0 ? data.boundsMax : glm::max(model->boundsMax, data.boundsMax);
+        }
+        model->meshes = BuildMeshes(job.data.meshes, images, ids);
+        for (const std::vector<MeshData>& lod : job.data.lods)
+            model->lods.push_back(BuildMeshes(lod, images, ids));
+        job.data = AssetData();  // Free the CPU copies
+        *job.model = model;
+    }
+
+    static std::vector<Mesh> BuildMeshes(const std::vector<MeshData>& meshes, const std::vector<ImageData>& images,
+        const std::vector<unsigned int>& ids)
+    {
+        std::vector<Mesh> result;
+        result.reserve(meshes.size());
+        for (const MeshData& data : meshes) {
+            std::vector<Texture> textures;
+            for (int image : data.images) {
+                Texture texture;
+                texture.id = ids[image];
+                texture.type = images[image].type;
+                texture.path = images[image].path;
+                textures.push_back(texture);
+            }
+            result.push_back(Mesh(data.vertices, data.indices, textures));  // Mesh sets up its VAO
+        }
+        return result;
+    }
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "rng.h"
+#include "world.h"
+
+// Plays a World by producing its SimInput each tick from the World's own
+// state, for mass simulation when tuning the rules. A new bot is another
+// Kind and a case in Decide().
+class Bot {
+public:
+    enum Kind { IDLE, RANDOM, GREEDY };
+
+    Kind kind = GREEDY;
+    float steersPerSecond = 1.0f;  // RANDOM: average lane change requests per second
+    float reactionTime = 0.2f;     // GREEDY: seconds before a lane change starts that it looks past
+
+    Bot(Kind kind = GREEDY, uint64_t seed = 0) : kind(kind), rng(seed, 1) {}
+
+    static bool ParseKind(const char* name, Kind& kind)
+    {
+        if (strcmp(name, "idle") == 0) kind = IDLE;
+        else if (strcmp(name, "random") == 0) kind = RANDOM;
+        else if (strcmp(name, "greedy") == 0) kind = GREEDY;
+        else return false;
+        return true;
+    }
+
+    static const char* KindName(Kind kind)
+    {
+        const char* names[] = { "idle", "random", "greedy" };
+        return names[kind];
+    }
+
+    SimInput Decide(const World& world)
+    {
+        SimInput input;
+        if (world.isChangingLane || world.gameOver)
+            return input;
+        switch (kind) {
+        case IDLE:
+            break;
+        case RANDOM:
+            if (rng.NextFloat() < steersPerSecond * SIM_DT) {
+                if (rng.NextInt(2)) input.steerLeft = true;
+                else input.steerRight = true;
+            }
+            break;
+        case GREEDY:
+            input = Greedy(world);
+            break;
+        }
+        return input;
+    }
+
+private:
+    Rng rng;
+
+    // Stays in lane until an obstacle comes within the distance a lane change
+    // (plus the reaction time) covers, then moves to whichever neighbouring
+    // lane is clear the furthest, if that is further than its own
+    SimInput Greedy(const World& world) const
+    {
+        float ahead[3];
+        ClearAhead(world, ahead);
+        SimInput input;
+        int lane = world.playerLane;
+        float reach = world.speed * (1.0f / world.laneChangeSpeed + reactionTime);
+        if (ahead[lane] > reach)
+            return input;
+        int best = lane;
+        if (lane > 0 && ahead[lane - 1] > ahead[best]) best = lane - 1;
+        if (lane < 2 && ahead[lane + 1] > ahead[best]) best = lane + 1;
+        if (best < lane) input.steerRight = true;
+        else if (best > lane) input.steerLeft = true;
+        return input;
+    }
+
+    // Distance from the car to the nearest obstacle it hasn't passed, per
+    // lane; obstacles are in Z order, so the first found in a lane is it
+    static void ClearAhead(const World& world, float ahead[3])
+    {
+        const float FAR_AWAY = 1e9f;
+        ahead[0] = ahead[1] = ahead[2] = FAR_AWAY;
+        int found = 0;
+        const ObstaclePool& obstacles = world.obstacles;
+        for (int slot = 0; slot < obstacles.size() && found < 3; slot++) {
+            int lane = obstacles.lane[slot];
+            float z = obstacles.z[slot];
+            if (ahead[lane] != FAR_AWAY || z + OBSTACLE_HALF_EXTENTS[obstacles.type[slot]].y + CAR_HALF_EXTENTS.y <= world.carZ)
+                continue;
+            ahead[lane] = z - world.carZ;
+            found++;
+        }
+    }
+};
+
+#endif
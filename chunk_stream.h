@@ -0,0 +1,126 @@
+#ifndef CHUNK_STREAM_H
+#define CHUNK_STREAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "rng.h"
+
+// What one road chunk holds, as lane and type picks the World turns into
+// obstacles and buildings
+struct ChunkContents {
+    long long index;
+    bool hasObstacle;
+    int obstacleLane, obstacleType;
+    float obstacleZ;
+    bool hasBuildings;
+    int leftBuildingType, rightBuildingType;
+    float buildingZ;
+};
+
+// Spawn rules. A chunk's contents are a pure function of these, the seed and
+// the chunk index, so any thread can generate any chunk in any order.
+struct ChunkRules {
+    uint64_t seed = 0;
+    float segmentSize = 20.0f;
+    float firstObstacleZ = 80.0f;  // Chunks starting before this get no obstacle
+    int buildingChunkInterval = 3;
+
+    ChunkContents Generate(long long index) const
+    {
+        // A PCG stream of its own per chunk, with the seed scrambled per
+        // index too since neighbouring streams of one seed are correlated
+        Rng rng(seed ^ ((uint64_t)index * 0x9E3779B97F4A7C15ULL), (uint64_t)index);
+        float zStart = index * segmentSize;
+
+        ChunkContents c = {};
+        c.index = index;
+        c.hasObstacle = zStart >= firstObstacleZ;
+        c.obstacleLane = rng.NextInt(3);
+        c.obstacleType = rng.NextInt(3);
+        c.obstacleZ = zStart + rng.NextInt((int)segmentSize);
+        c.hasBuildings = index % buildingChunkInterval == 0;
+        c.leftBuildingType = rng.NextInt(4);
+        c.rightBuildingType = rng.NextInt(4);
+        c.buildingZ = zStart + rng.NextInt((int)segmentSize);
+        return c;
+    }
+};
+
+// Generates chunks ahead of the World on a worker thread. The worker is the
+// only producer and the World the only consumer of a fixed ring indexed by
+// two atomics, so neither side ever takes a lock or waits on the other.
+class ChunkStream {
+public:
+    static const int CAPACITY = 64;  // Chunks generated ahead, at most
+
+    ~ChunkStream() { Stop(); }
+
+    // (Re)starts generation from firstChunk with new rules, dropping
+    // anything generated for the previous run
+    void Start(const ChunkRules& chunkRules, long long firstChunk)
+    {
+        Stop();
+        rules = chunkRules;
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        wanted.store(firstChunk, std::memory_order_relaxed);
+        running.store(true, std::memory_order_release);
+        worker = std::thread(&ChunkStream::Work, this, firstChunk);
+    }
+
+    void Stop()
+    {
+        running.store(false, std::memory_order_release);
+        if (worker.joinable()) worker.join();
+    }
+
+    // Contents of chunk index, taken from the ring when the worker has it
+    // ready and generated on the calling thread otherwise. Earlier chunks
+    // still in the ring were skipped by the caller and are dropped.
+    ChunkContents Take(long long index)
+    {
+        wanted.store(index + 1, std::memory_order_relaxed);
+        unsigned int t = tail.load(std::memory_order_relaxed);
+        while (t != head.load(std::memory_order_acquire)) {
+            ChunkContents c = ring[t % CAPACITY];  // Copied out before the slot is released
+            if (c.index > index) break;
+            tail.store(++t, std::memory_order_release);
+            if (c.index == index) return c;
+        }
+        misses++;
+        return rules.Generate(index);
+    }
+
+    int Misses() const { return misses; }  // Chunks the consumer had to generate itself
+
+private:
+    ChunkRules rules;
+    ChunkContents ring[CAPACITY];
+    std::atomic<unsigned int> head{ 0 };  // Next slot the worker writes
+    std::atomic<unsigned int> tail{ 0 };  // Next slot the consumer reads
+    std::atomic<long long> wanted{ 0 };   // The consumer never needs chunks before this again
+    std::atomic<bool> running{ false };
+    std::thread worker;
+    int misses = 0;
+
+    void Work(long long next)
+    {
+        while (running.load(std::memory_order_acquire)) {
+            unsigned int h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) == CAPACITY) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            // Catch up when the car outran the ring
+            long long skipTo = wanted.load(std::memory_order_relaxed);
+            if (next < skipTo) next = skipTo;
+            ring[h % CAPACITY] = rules.Generate(next++);
+            head.store(h + 1, std::memory_order_release);
+        }
+    }
+};
+
+#endif
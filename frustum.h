@@ -0,0 +1,93 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <vector>
+
+// World-space axis-aligned boxes kept as one array per coordinate, so the
+// cull loop reads them with unit stride
+struct AabbList {
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+    size_t Size() const { return minX.size(); }
+
+    void Clear()
+    {
+        minX.clear(); minY.clear(); minZ.clear();
+        maxX.clear(); maxY.clear(); maxZ.clear();
+    }
+
+    void Add(const glm::vec3& lo, const glm::vec3& hi)
+    {
+        minX.push_back(lo.x); minY.push_back(lo.y); minZ.push_back(lo.z);
+        maxX.push_back(hi.x); maxY.push_back(hi.y); maxZ.push_back(hi.z);
+    }
+
+    // Adds the box that encloses a model-space box after the transform
+    void AddTransformed(const glm::mat4& m, const glm::vec3& lo, const glm::vec3& hi)
+    {
+        glm::vec3 outMin, outMax;
+        Transform(m, lo, hi, outMin, outMax);
+        Add(outMin, outMax);
+    }
+
+    static void Transform(const glm::mat4& m, const glm::vec3& lo, const glm::vec3& hi, glm::vec3& outMin, glm::vec3& outMax)
+    {
+        glm::vec3 center = (lo + hi) * 0.5f, extent = (hi - lo) * 0.5f;
+        glm::vec3 c = glm::vec3(m * glm::vec4(center, 1.0f));
+        glm::vec3 e;
+        for (int row = 0; row < 3; row++)
+            e[row] = std::fabs(m[0][row]) * extent.x + std::fabs(m[1][row]) * extent.y + std::fabs(m[2][row]) * extent.z;
+        outMin = c - e;
+        outMax = c + e;
+    }
+};
+
+// The six clip planes of a view-projection matrix. A box is culled only when
+// it lies entirely behind one plane, so a few boxes near the corners pass
+// although they are outside; that only costs a draw.
+class Frustum {
+public:
+    void Extract(const glm::mat4& viewProjection)
+    {
+        const glm::mat4& m = viewProjection;
+        for (int i = 0; i < 3; i++) {
+            for (int s = 0; s < 2; s++) {
+                float sign = s == 0 ? 1.0f : -1.0f;
+                int p = i * 2 + s;
+                planes[p][0] = m[0][3] + sign * m[0][i];
+                planes[p][1] = m[1][3] + sign * m[1][i];
+                planes[p][2] = m[2][3] + sign * m[2][i];
+                planes[p][3] = m[3][3] + sign * m[3][i];
+            }
+        }
+    }
+
+    // Sets visible[i] to 1 for every box that may be in view, 0 otherwise,
+    // and returns how many are. Each plane tests all boxes against its
+    // nearest corner in one branch-free loop, which compilers vectorise.
+    int Cull(const AabbList& boxes, std::vector<unsigned char>& visible) const
+    {
+        size_t n = boxes.Size();
+        visible.assign(n, 1);
+        unsigned char* out = visible.data();
+        for (int p = 0; p < 6; p++) {
+            float a = planes[p][0], b = planes[p][1], c = planes[p][2], d = planes[p][3];
+            const float* xs = a >= 0.0f ? boxes.maxX.data() : boxes.minX.data();
+            const float* ys = b >= 0.0f ? boxes.maxY.data() : boxes.minY.data();
+            const float* zs = c >= 0.0f ? boxes.maxZ.data() : boxes.minZ.data();
+            for (size_t i = 0; i < n; i++)
+                out[i] &= (unsigned char)(a * xs[i] + b * ys[i] + c * zs[i] + d >= 0.0f);
+        }
+        int count = 0;
+        for (size_t i = 0; i < n; i++) count += out[i];
+        return count;
+    }
+
+private:
+    float planes[6][4] = {};  // a, b, c, d with ax + by + cz + d >= 0 inside
+};
+
+#endif
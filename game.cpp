@@ -6,108 +6,408 @@
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
-#include <learnopengl/model.h>
 #include <stb_image.h>
 
-#include <ft2build.h>
-#include FT_FREETYPE_H
-
 #include <iostream>
 #include <vector>
-#include <deque>
 #include <cstdlib>
+#include <cstdio>
+#include <cstddef>
 #include <ctime>
 #include <string>
-#include <map>
+#include <chrono>
+#include <deque>
+
+#include "world.h"
+#include "text_renderer.h"
+#include "profiler.h"
+#include "gpu_timer.h"
+#include "replay.h"
+#include "png_writer.h"
+#include "asset_loader.h"
+#include "render_queue.h"
+#include "lod.h"
+#include "frustum.h"
+#include "transform_table.h"
+#include "static_instances.h"
+#include "gl_state.h"
+#include "sim_thread.h"
+#include "bot.h"
+#include "microbench.h"
 
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
 Camera camera(glm::vec3(0.0f, 5.0f, -5.0f));
+const float CAMERA_FOV = 45.0f;  // Vertical, degrees
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 // Camera view mode
 bool isFirstPersonView = false;
 
-glm::vec3 lanes[3] = { {-3.0f,0.0f,0.0f}, {0.0f,0.0f,0.0f}, {3.0f,0.0f,0.0f} };
-int playerLane = 1;
-
-// Lane transition variables
-bool isChangingLane = false;
-int targetLane = 1;
-float laneChangeProgress = 0.0f;
-float laneChangeSpeed = 2.0f; // Time to complete lane change
-float currentCarX = 0.0f;
-float carRotationY = 0.0f;
-
-Model* playerCar;
-Model* stopSignModel;
-Model* coneModel;
-Model* barrelModel;
-
-Model* buildingModels[4]; // b2,b3,b4,b5
+// Gameplay state lives in the World; the loop feeds it fixed ticks
+World world;
+ChunkStream chunkStream;  // Generates the World's road chunks ahead on a worker thread
+FixedTimestep simClock;
+SimInput pendingInput;  // Lane requests waiting for the next tick
+
+// Rendering only reads the World through snapshots. With --threaded the World
+// steps on simThread, which publishes one per tick; otherwise the frame loop
+// steps it and publishes one per frame. Everything the frame loop changes in
+// the World (resets, input) happens under simThread.mutex.
+TripleBuffer<WorldSnapshot> worldSnapshots;
+SimThread simThread;
+bool threaded = false;
+Profiler simProfiler;  // Sim thread sections in threaded mode; read under simThread.mutex
+// Keys as GLFW reports them from glfwPollEvents(), stamped on arrival, so a
+// tap shorter than a frame still registers; processInput() drains them
+struct KeyEvent {
+    int key, action;
+    double time;  // SimThread::Clock()
+};
+RingBuffer<KeyEvent, 64> keyEvents;
+// Lane requests are numbered and keep their key's time stamp, so the frame
+// that first shows one can report input-to-photon latency
+uint64_t pendingInputId = 0, consumedInputId = 0, shownInputId = 0;
+double pendingInputTime = 0.0, consumedInputTime = 0.0;
+
+LoadedModel* playerCar;
+LoadedModel* stopSignModel;
+LoadedModel* coneModel;
+LoadedModel* barrelModel;
+
+LoadedModel* buildingModels[4]; // b2,b3,b4,b5
+
+// Instanced draw path: one per-instance buffer per LOD level of a model,
+// refilled each frame, so every mesh of a level is drawn once for all the
+// instances that picked it. The buffer holds model matrices, or for batches
+// of static instances only their slots in a StaticInstances store.
+struct InstanceBatch {
+    struct Part {
+        unsigned int VAO;
+        int indexCount;
+        Material material;
+    };
+    struct Level {
+        std::vector<Part> parts;
+        unsigned int instanceVBO;
+        std::vector<glm::mat4> matrices;  // Keeps its capacity between frames
+        std::vector<int> slots;           // Instead of matrices for static batches
+        bool impostor = false;
+    };
+    LoadedModel* model;
+    StaticInstances* instances = NULL;  // Set for static batches
+    std::vector<Level> levels;  // The model's LODs, then one per impostor view if baked
+    int lodCount = 0;
+    bool hasImpostor = false;
+    glm::vec3 center;  // Model-space bounding sphere, for LOD selection
+    float radius = 0.0f;
+};
+InstanceBatch obstacleBatches[3];  // By Obstacle::type
+InstanceBatch buildingBatches[4];  // By Building::type
+LodSettings lodSettings = LodSettings::ForQuality(LodSettings::MEDIUM);
+Shader* impostorShader = NULL;  // Only created when the quality level uses impostors
+
+// Buildings never move, so what the renderer needs per building is worked out
+// once when it appears: its matrix goes into buildingInstances and the rest
+// stays in bakedBuildings, both in BuildingList order
+struct BakedBuilding {
+    int type;
+    glm::vec3 center;  // World-space bounding sphere, for LOD selection
+    float radius;
+    glm::vec3 boundsMin, boundsMax;  // World-space box, for culling
+    glm::mat3 toModel;  // World to model-space directions, for impostor views
+};
+StaticInstances buildingInstances;
+RingBuffer<BakedBuilding, BuildingList::CAPACITY> bakedBuildings;
+uint64_t bakedFirstId = 0;     // BuildingList id of bakedBuildings.front()
+Shader* buildingShader = NULL;  // shader_static_instanced.vs
 
 unsigned int roadVAO, roadTexture;
 unsigned int grassVAO, grassTexture;
 unsigned int footpathVAO, footpathTexture;
 unsigned int curbVAO, curbTexture;
 
+// Everything renderObjects() draws goes through the queue, sorted to
+// minimise state changes
+RenderQueue renderQueue;
+// Camera constants for all scene shaders, and the filter every scene bind and
+// uniform write goes through
+FrameUniforms frameUniforms;
+GlState glState;
+std::vector<Material> carMaterials;  // Per mesh of playerCar
+Material grassMaterial, roadMaterial, curbMaterial, footpathMaterial;
+
+// Per-segment matrices shared by the road, curb and footpath instanced draws,
+// for the segments in view
+unsigned int roadInstanceVBO;
+std::vector<float> roadInstanceZ;  // zStart of the segments last uploaded
+std::vector<glm::mat4> roadInstanceMatrices;
+
+// Bounds of everything renderObjects() may draw, in one flat array culled
+// against the camera in one pass: the car, then road segments, obstacles
+// and buildings in World order
+Frustum viewFrustum;
+AabbList sceneBounds;
+std::vector<unsigned char> sceneVisible;
+std::vector<float> visibleRoadZ;
+std::vector<glm::mat4> obstacleMatrices;
+
+// Model matrices per obstacle type and per building type and side, placed
+// for all entities at once from the World's arrays
+TransformTable obstacleTransforms;  // By type
+TransformTable buildingTransforms;  // By type * 2 + leftSide
+std::vector<int> buildingVariants;  // Of the buildings being baked
+std::vector<float> buildingX, buildingZ;
+std::vector<glm::mat4> buildingMatrices;
 
-struct RoadSegment { float zStart; };
-std::deque<RoadSegment> roadSegments;
-float segmentSize = 20.0f;
-
-float carZ = 0.0f;
-float speed = 20.0f;
-float baseSpeed = 20.0f;  // Store the original base speed
-int lastSpeedIncreaseScore = 0;  // Track when we last increased speed
-
-struct Obstacle {
-    glm::vec3 pos;
-    int type; // 0=StopSign, 1=Cone, 2=Barrel
-};
-std::vector<Obstacle> obstacles;
-
-struct Building {
-    glm::vec3 pos;
-    int type; // 0=b2,1=b3,2=b4,3=b5
-    bool leftSide;
-};
-std::vector<Building> buildings;
-
-float distanceTraveled = 0.0f;
-int totalScore = 0;
-bool gameOver = false;
 bool gameStarted = false;  // Track if game has started
 
-// Text rendering structures
-struct Character {
-    unsigned int TextureID;
-    glm::ivec2 Size;
-    glm::ivec2 Bearing;
-    unsigned int Advance;
+// HUD and menu text, batched into one draw per frame
+TextRenderer textRenderer;
+
+// Retained HUD: labels keep their text, width and quads, and are only rebuilt
+// when the value they show changes
+struct Hud {
+    TextLabel menu[5];
+    TextLabel score, distance, speed;
+    TextLabel gameOver, finalScore, restart, backToMenu;
+
+    // Values currently shown; -1 forces the first build
+    int shownScore = -1;
+    int shownDistance = -1;
+    int shownSpeed = -1;
+    int shownFirstPerson = -1;
+    int shownGameOver = -1;
 };
-
-std::map<GLchar, Character> Characters;
-unsigned int textVAO, textVBO;
+Hud hud;
+
+// Frame profiler; F3 toggles the overlay, --trace <file> records a Chrome trace
+Profiler profiler;
+GpuTimer gpuTimer;
+RenderStats renderStats;      // Counts for the frame being drawn
+RenderStats lastRenderStats;  // Counts of the previous frame, for the overlay
+
+struct ProfilerOverlay {
+    bool visible = false;
+    float nextRefresh = 0.0f;  // Stats are re-formatted twice a second
+    TextLabel lines[PROFILE_SECTION_COUNT + 2];
+};
+ProfilerOverlay profilerOverlay;
+
+// Run seeding, recording and replay. Each run gets a seed from sessionRng
+// unless --seed pins it; --record saves every run's input log, --replay plays
+// a log back instead of reading the keyboard.
+Rng sessionRng;
+bool seedPinned = false;
+uint64_t pinnedSeed = 0;
+std::string recordPath;
+InputLog inputLog;  // Run being recorded, or the log being replayed
+InputReplay replay;
+bool replaying = false;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void key_callback(GLFWwindow*, int key, int, int action, int);
+void queueKeyEvent(int key, int action, double time);
 void processInput(GLFWwindow* window);
-void renderObjects(Shader& shader);
-void spawnObstacles();
-void spawnBuildings();
-void generateRoadIfNeeded();
+void renderObjects(const WorldSnapshot& snap, float alpha, Shader& shader, Shader& instancedShader, const glm::mat4& viewProjection);
+void attachInstanceMatrices(unsigned int VAO);
+void attachInstanceSlots(unsigned int VAO);
+unsigned int instancedMeshVao(const Mesh& mesh);
+void setupInstanceBatch(InstanceBatch& batch, LoadedModel* model, StaticInstances* instances = NULL);
+Impostor bakeImpostor(LoadedModel& model, Shader& shader);
+void setupImpostor(InstanceBatch& batch, const Impostor& impostor);
+int selectLod(const InstanceBatch& batch, const glm::vec3& center, float radius);
+void addInstance(InstanceBatch& batch, const glm::mat4& model);
+void addStaticInstance(InstanceBatch& batch, const BakedBuilding& building, int slot);
+void syncBuildings(const BuildingList& buildings);
+void queueInstanceBatch(InstanceBatch& batch, Shader& instancedShader);
+Shader* levelShader(const InstanceBatch& batch, const InstanceBatch::Level& level, Shader& instancedShader);
+glm::mat4 obstacleModelMatrix(const Obstacle& obs);
+glm::mat4 buildingModelMatrix(const Building& b);
+void setupTransformTables();
 void resetGame();
-unsigned int loadTexture(const std::string& path);
-void RenderText(Shader& shader, std::string text, float x, float y, float scale, glm::vec3 color);
-float GetTextWidth(std::string text, float scale);
-
-int main()
+World configuredWorld();
+void simulateTick();
+void publishSnapshot();
+void reportInputLatency(const WorldSnapshot& snap);
+void saveRecording();
+const char* argValue(int argc, char** argv, const char* flag);
+bool hasArg(int argc, char** argv, const char* flag);
+void queueAssets(AssetLoader& assets);
+void setupHud();
+void drawMenu(Shader& textShader);
+void updateHud(GLFWwindow* window, const WorldSnapshot& snap);
+void drawProfilerOverlay(float now);
+int runHeadless(float simSeconds);
+int runSoak(float simSeconds);
+int runEntityBench(int count);
+int runContainerBench(int count);
+int runInputBench(int taps);
+int runBots(int games, Bot::Kind kind, const World& rules, float maxSeconds, int threads);
+int runMicroBench(const std::string& jsonPath, const std::string& filter, const char* executable);
+int runReplay(const std::string& path);
+int runBench(GLFWwindow* window, int frames, int snapshotEvery, const std::string& snapshotDir,
+    Shader& shader, Shader& instancedShader, Shader& textShader);
+void renderGame(GLFWwindow* window, const WorldSnapshot& snap, float alpha,
+    Shader& shader, Shader& instancedShader, Shader& textShader, float now);
+void finishTrace(const std::string& path);
+
+int main(int argc, char** argv)
 {
-    srand((unsigned int)time(0));
+    sessionRng.Seed((uint64_t)time(0));
+    setupTransformTables();
+
+    // --seed <n>: every run uses this seed, so obstacles and buildings repeat
+    if (const char* seed = argValue(argc, argv, "--seed")) {
+        seedPinned = true;
+        pinnedSeed = strtoull(seed, NULL, 10);
+        sessionRng.Seed(pinnedSeed);
+    }
 
+    // --trace <file>: record a Chrome trace of the whole session
+    std::string tracePath;
+    if (const char* path = argValue(argc, argv, "--trace")) tracePath = path;
+    if (!tracePath.empty()) profiler.StartTrace();
+
+    // --threaded: step the simulation on its own thread and draw the newest
+    // snapshot it published, interpolated to the frame time
+    threaded = hasArg(argc, argv, "--threaded") && !hasArg(argc, argv, "--bench");
+    if (threaded && !tracePath.empty()) simProfiler.StartTrace();
+
+    // --record <file>: save the input log of each run (overwritten per run)
+    if (const char* path = argValue(argc, argv, "--record")) recordPath = path;
+
+    // --replay <file>: drive the game from a recorded log
+    std::string replayPath;
+    if (const char* path = argValue(argc, argv, "--replay")) replayPath = path;
+
+    // --base-speed, --lane-change-speed, --segment-size (obstacle spacing,
+    // one per chunk), --first-obstacle-z: override the gameplay rules for
+    // play and every headless mode; replays only match under the rules they
+    // were recorded with
+    if (const char* value = argValue(argc, argv, "--base-speed")) world.baseSpeed = (float)atof(value);
+    if (const char* value = argValue(argc, argv, "--lane-change-speed")) world.laneChangeSpeed = (float)atof(value);
+    if (const char* value = argValue(argc, argv, "--segment-size")) world.segmentSize = (float)atof(value);
+    if (const char* value = argValue(argc, argv, "--first-obstacle-z")) world.firstObstacleZ = (float)atof(value);
+
+    // --headless [seconds]: run the simulation only, no window or GL context.
+    // With --replay, plays the log back headless and prints the final state.
+    if (hasArg(argc, argv, "--headless")) {
+        if (!replayPath.empty())
+            return runReplay(replayPath);
+        const char* seconds = argValue(argc, argv, "--headless");
+        return runHeadless(seconds ? (float)atof(seconds) : 3600.0f);
+    }
+    // --soak [seconds]: one uninterrupted run with collisions off, reporting tick cost over time
+    if (hasArg(argc, argv, "--soak")) {
+        const char* seconds = argValue(argc, argv, "--soak");
+        return runSoak(seconds ? (float)atof(seconds) : 3600.0f);
+    }
+    // --bench-entities [count]: time model matrix generation for that many
+    // obstacles and buildings, per-object against the transform tables
+    if (hasArg(argc, argv, "--bench-entities")) {
+        const char* count = argValue(argc, argv, "--bench-entities");
+        return runEntityBench(count ? atoi(count) : 10000);
+    }
+    // --bench-containers [count]: check RingBuffer's edge cases, then stream
+    // that many items through a full building window with front erasure,
+    // std::deque and RingBuffer
+    if (hasArg(argc, argv, "--bench-containers")) {
+        const char* count = argValue(argc, argv, "--bench-containers");
+        return runContainerBench(count ? atoi(count) : 1000000);
+    }
+    // --bench-input [taps]: key-down to lane-change start in ticks, for keys
+    // polled once per frame against key events
+    if (hasArg(argc, argv, "--bench-input")) {
+        const char* taps = argValue(argc, argv, "--bench-input");
+        return runInputBench(taps ? atoi(taps) : 1000);
+    }
+    // --bots [games]: play that many headless games in parallel with a bot
+    // (--bot idle|random|greedy, default greedy) under the rules above and
+    // report the distances reached; --threads <n> (default: one per core),
+    // --max-seconds <s> ends games that run longer (default 600)
+    if (hasArg(argc, argv, "--bots")) {
+        Bot::Kind kind = Bot::GREEDY;
+        if (const char* name = argValue(argc, argv, "--bot")) {
+            if (!Bot::ParseKind(name, kind)) {
+                std::cout << "Unknown bot: " << name << " (idle, random or greedy)" << std::endl;
+                return -1;
+            }
+        }
+        const char* games = argValue(argc, argv, "--bots");
+        const char* threads = argValue(argc, argv, "--threads");
+        const char* maxSeconds = argValue(argc, argv, "--max-seconds");
+        return runBots(games ? atoi(games) : 1000, kind, world,
+            maxSeconds ? (float)atof(maxSeconds) : 600.0f, threads ? atoi(threads) : 0);
+    }
+    // --bench-micro [out.json]: time the hot paths one by one (transforms,
+    // text layout, world ticks) and optionally write Google Benchmark JSON
+    // for diffing between commits; --bench-filter <text> runs only the
+    // benchmarks whose name contains it
+    if (hasArg(argc, argv, "--bench-micro")) {
+        const char* json = argValue(argc, argv, "--bench-micro");
+        const char* filter = argValue(argc, argv, "--bench-filter");
+        return runMicroBench(json ? json : "", filter ? filter : "", argv[0]);
+    }
+
+    // --bake: fill the asset cache (no window needed) and exit;
+    // --no-cache: always load from the source files
+    bool useAssetCache = !hasArg(argc, argv, "--no-cache");
+
+    // --quality low|medium|high: how early buildings and obstacles switch to
+    // simplified meshes, and whether far buildings become impostors
+    if (const char* quality = argValue(argc, argv, "--quality")) {
+        LodSettings::Quality level;
+        if (!LodSettings::ParseQuality(quality, level)) {
+            std::cout << "Unknown quality level: " << quality << " (low, medium or high)" << std::endl;
+            return -1;
+        }
+        lodSettings = LodSettings::ForQuality(level);
+    }
+
+    // --view-distance <units>: how far ahead of the car road is loaded
+    // (default 300); spawning follows the road, so replays are unaffected
+    if (const char* distance = argValue(argc, argv, "--view-distance"))
+        world.roadChunksAhead = std::max(1, (int)std::ceil(atof(distance) / world.segmentSize));
+    if (hasArg(argc, argv, "--bake")) {
+        AssetLoader baker;
+        queueAssets(baker);
+        baker.Bake();
+        return 0;
+    }
+
+    if (!replayPath.empty()) {
+        if (!inputLog.Load(replayPath)) {
+            std::cout << "Failed to load replay: " << replayPath << std::endl;
+            return -1;
+        }
+        replay = InputReplay(&inputLog);
+        replaying = true;
+        gameStarted = true;
+    }
+
+    // --bench <frames>: render that many frames offscreen as fast as possible and
+    // report fps and per-section timings; --snapshot-every <n> writes every nth
+    // frame to --snapshot-dir (default: current directory) as PNG
+    int benchFrames = 0, snapshotEvery = 0;
+    std::string snapshotDir = ".";
+    if (const char* frames = argValue(argc, argv, "--bench")) benchFrames = atoi(frames);
+    if (const char* every = argValue(argc, argv, "--snapshot-every")) snapshotEvery = atoi(every);
+    if (const char* dir = argValue(argc, argv, "--snapshot-dir")) snapshotDir = dir;
+    bool offscreen = benchFrames > 0;
+
+    bool nullPlatform = false;
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+    // No display server (build machines): GLFW's null platform with an EGL or
+    // OSMesa context, e.g. Mesa surfaceless EGL on llvmpipe
+    if (offscreen && !getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY")) {
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+        nullPlatform = true;
+    }
+#endif
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -115,40 +415,64 @@ int main()
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
-
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "3-Lane Car Avoidance", NULL, NULL);
+    if (offscreen) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);  // Frames go to an FBO
+
+    GLFWwindow* window = NULL;
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+    if (nullPlatform) {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "3-Lane Car Avoidance", NULL, NULL);
+        if (!window) {
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+            window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "3-Lane Car Avoidance", NULL, NULL);
+        }
+    }
+#endif
+    if (!nullPlatform)
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "3-Lane Car Avoidance", NULL, NULL);
     if (!window) { std::cout << "Failed to create GLFW window\n"; glfwTerminate(); return -1; }
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetKeyCallback(window, key_callback);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) { std::cout << "Failed to initialize GLAD\n"; return -1; }
 
     glEnable(GL_DEPTH_TEST);
 
     Shader shader("1.2.depth_testing.vs", "1.2.depth_testing.fs");
+    Shader instancedShader("shader_instanced.vs", "1.2.depth_testing.fs");
+    Shader staticInstancedShader("shader_static_instanced.vs", "1.2.depth_testing.fs");
+    Shader impostorProgram("shader_static_instanced.vs", "impostor.fs");
+    buildingShader = &staticInstancedShader;
+    if (lodSettings.impostorBelow > 0.0f) impostorShader = &impostorProgram;
+    buildingInstances.Init();
+    for (Shader* s : { &staticInstancedShader, &impostorProgram }) {
+        s->use();
+        s->setInt("instanceMatrices", StaticInstances::TEXTURE_UNIT);
+    }
+    frameUniforms.Init();
+    for (Shader* s : { &shader, &instancedShader, &staticInstancedShader, &impostorProgram }) {
+        frameUniforms.Attach(*s);
+        glState.Register(*s);
+    }
 
-    // Text rendering shader
-    Shader textShader(
-        FileSystem::getPath("src/7.in_practice/2.text_rendering/text.vs").c_str(),
-        FileSystem::getPath("src/7.in_practice/2.text_rendering/text.fs").c_str()
-    );
-
-    // Load models
-    playerCar = new Model(FileSystem::getPath("resources/project/car/Jeep_Renegade_2016.obj"));
-    stopSignModel = new Model(FileSystem::getPath("resources/project/StopSign/StopSign.obj"));
-    coneModel = new Model(FileSystem::getPath("resources/project/cone/TrafficCone.obj"));
-    barrelModel = new Model(FileSystem::getPath("resources/project/barrel/barrel.obj"));
-    buildingModels[0] = new Model(FileSystem::getPath("resources/project/building/b2/b2.obj"));
-    buildingModels[1] = new Model(FileSystem::getPath("resources/project/building/b3/b3.obj"));
-    buildingModels[2] = new Model(FileSystem::getPath("resources/project/building/b4/b4.obj"));
-    buildingModels[3] = new Model(FileSystem::getPath("resources/project/building/b5/b5.obj"));
+    // Text rendering shader (per-vertex colour so all text shares one draw)
+    Shader textShader("text_batch.vs", "text_batch.fs");
+
+    // Models and textures are loaded (from the asset cache when it is up to
+    // date) on worker threads while the rest of startup runs; the menu shows
+    // progress until they're uploaded
+    AssetLoader assets;
+    assets.UseCache = useAssetCache;
+    queueAssets(assets);
+    assets.Start();
 
     // ----- ROAD -----
     float roadVertices[] = {
-        -5.0f, 0.01f, 0.0f,    0.0f,1.0f,0.0f,  1.0f, 0.0f,
-         5.0f, 0.01f, 0.0f,    0.0f,1.0f,0.0f,  1.0f, 1.0f,
-         5.0f, 0.01f, segmentSize, 0.0f,1.0f,0.0f, 0.0f, 1.0f,
-        -5.0f, 0.01f, segmentSize, 0.0f,1.0f,0.0f, 0.0f, 0.0f
+        -5.0f, 0.02f, 0.0f,    0.0f,1.0f,0.0f,  1.0f, 0.0f,
+         5.0f, 0.02f, 0.0f,    0.0f,1.0f,0.0f,  1.0f, 1.0f,
+         5.0f, 0.02f, world.segmentSize, 0.0f,1.0f,0.0f, 0.0f, 1.0f,
+        -5.0f, 0.02f, world.segmentSize, 0.0f,1.0f,0.0f, 0.0f, 0.0f
     };
     unsigned int roadIndices[] = { 0,1,2, 2,3,0 };
     unsigned int roadVBO, roadEBO;
@@ -203,14 +527,14 @@ int main()
         // Left side
         -11.0f + 0.15f, 0.2f, 0.0f,   0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
         -5.0f + 0.15f, 0.2f, 0.0f,   0.0f, 1.0f, 0.0f,  3.0f, 0.0f,
-        -5.0f + 0.15f, 0.2f, segmentSize, 0.0f, 1.0f, 0.0f,  3.0f, 8.0f,
-        -11.0f + 0.15f, 0.2f, segmentSize, 0.0f, 1.0f, 0.0f,  0.0f, 8.0f,
+        -5.0f + 0.15f, 0.2f, world.segmentSize, 0.0f, 1.0f, 0.0f,  3.0f, 8.0f,
+        -11.0f + 0.15f, 0.2f, world.segmentSize, 0.0f, 1.0f, 0.0f,  0.0f, 8.0f,
 
         // Right side
          11.0f - 0.15f, 0.2f, 0.0f,   0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
           5.0f - 0.15f, 0.2f, 0.0f,   0.0f, 1.0f, 0.0f,  3.0f, 0.0f,
-          5.0f - 0.15f, 0.2f, segmentSize, 0.0f, 1.0f, 0.0f,  3.0f, 8.0f,
-         11.0f - 0.15f, 0.2f, segmentSize, 0.0f, 1.0f, 0.0f,  0.0f, 8.0f,
+          5.0f - 0.15f, 0.2f, world.segmentSize, 0.0f, 1.0f, 0.0f,  3.0f, 8.0f,
+         11.0f - 0.15f, 0.2f, world.segmentSize, 0.0f, 1.0f, 0.0f,  0.0f, 8.0f,
     };
     unsigned int footpathIndices[] = {
         0, 1, 2, 2, 3, 0,   // Left
@@ -241,14 +565,14 @@ int main()
         // Left curb
         -5.0f + 0.15f, 0.2f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
         -4.8f + 0.15f, 0.2f, 0.0f,  0.0f, 1.0f, 0.0f,  5.0f, 0.0f,
-        -4.8f + 0.15f, 0.2f, segmentSize, 0.0f, 1.0f, 0.0f, 5.0f, 2.0f,
-        -5.0f + 0.15f, 0.2f, segmentSize, 0.0f, 1.0f, 0.0f, 0.0f, 2.0f,
+        -4.8f + 0.15f, 0.2f, world.segmentSize, 0.0f, 1.0f, 0.0f, 5.0f, 2.0f,
+        -5.0f + 0.15f, 0.2f, world.segmentSize, 0.0f, 1.0f, 0.0f, 0.0f, 2.0f,
 
         // Right curb
          4.8f - 0.15f, 0.2f, 0.0f,  0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
          5.0f - 0.15f, 0.2f, 0.0f,  0.0f, 1.0f, 0.0f,  5.0f, 0.0f,
-         5.0f - 0.15f, 0.2f, segmentSize, 0.0f, 1.0f, 0.0f, 5.0f, 2.0f,
-         4.8f - 0.15f, 0.2f, segmentSize, 0.0f, 1.0f, 0.0f, 0.0f, 2.0f
+         5.0f - 0.15f, 0.2f, world.segmentSize, 0.0f, 1.0f, 0.0f, 5.0f, 2.0f,
+         4.8f - 0.15f, 0.2f, world.segmentSize, 0.0f, 1.0f, 0.0f, 0.0f, 2.0f
     };
     unsigned int curbIndices[] = {
         0, 1, 2, 2, 3, 0,   // Left curb
@@ -274,656 +598,1608 @@ int main()
     glEnableVertexAttribArray(2);
     glBindVertexArray(0);
 
-    // Load texture
-    roadTexture = loadTexture(FileSystem::getPath("resources/project/road/3lane.jpg"));
-    grassTexture = loadTexture(FileSystem::getPath("resources/project/grass/grass.jpg"));
-    footpathTexture = loadTexture(FileSystem::getPath("resources/project/grass/brick1.jpg"));
-    curbTexture = loadTexture(FileSystem::getPath("resources/project/grass/redwhite1.jpg"));
-
-    // Initialize FreeType for text rendering
-    FT_Library ft;
-    if (FT_Init_FreeType(&ft)) {
-        std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
-        return -1;
-    }
+    // Road, curb and footpath are drawn as one instanced strip each
+    glGenBuffers(1, &roadInstanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, roadInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_DYNAMIC_DRAW);
+    attachInstanceMatrices(roadVAO);
+    attachInstanceMatrices(curbVAO);
+    attachInstanceMatrices(footpathVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+    // Glyph atlas for text rendering
     std::string font_name = FileSystem::getPath("resources/fonts/Antonio-Bold.ttf");
     if (font_name.empty()) {
         std::cout << "ERROR::FREETYPE: Failed to load font_name" << std::endl;
         return -1;
     }
-
-    FT_Face face;
-    if (FT_New_Face(ft, font_name.c_str(), 0, &face)) {
-        std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
+    if (!textRenderer.Load(font_name, 48))
         return -1;
-    }
-
-    FT_Set_Pixel_Sizes(face, 0, 48);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-    // Load first 128 ASCII characters
-    for (unsigned char c = 0; c < 128; c++) {
-        if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
-            std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
-            continue;
-        }
-
-        unsigned int texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RED,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer
-        );
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        Character character = {
-            texture,
-            glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-            glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-            static_cast<unsigned int>(face->glyph->advance.x)
-        };
-        Characters.insert(std::pair<char, Character>(c, character));
-    }
-    glBindTexture(GL_TEXTURE_2D, 0);
-    FT_Done_Face(face);
-    FT_Done_FreeType(ft);
-
-    // Configure VAO/VBO for text rendering
-    glGenVertexArrays(1, &textVAO);
-    glGenBuffers(1, &textVBO);
-    glBindVertexArray(textVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    setupHud();
 
     // Setup orthographic projection for text rendering
     glm::mat4 textProjection = glm::ortho(0.0f, (float)SCR_WIDTH, 0.0f, (float)SCR_HEIGHT);
     textShader.use();
     textShader.setMat4("projection", textProjection);
 
-    // Setup road segments
-    float groundLength = 1000.0f;
-    int numSegments = int(groundLength / segmentSize) + 2;
-    float startZ = -groundLength / 2;
-    for (int i = 0; i < numSegments; i++)
-        roadSegments.push_back({ startZ + i * segmentSize });
+    // Upload finished assets a few milliseconds per frame so the loading
+    // screen keeps drawing
+    while (!assets.Done()) {
+        if (offscreen) {
+            if (assets.Upload(100.0) == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        assets.Upload(8.0);
+        char progress[64];
+        snprintf(progress, sizeof(progress), "Loading... %d/%d", assets.Uploaded(), assets.Total());
+        hud.menu[4].SetText(textRenderer, progress);
+        drawMenu(textShader);
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+        if (glfwWindowShouldClose(window)) {
+            glfwTerminate();
+            return 0;
+        }
+    }
+    hud.menu[4].SetText(textRenderer, "Press SPACE to Start");
+    assets.PrintTimings();
+
+    // Impostors are captured with the plain Model::Draw, so before any
+    // instancing is set up
+    Impostor impostors[4];
+    if (impostorShader) {
+        for (int i = 0; i < 4; i++) impostors[i] = bakeImpostor(*buildingModels[i], shader);
+    }
+    setupInstanceBatch(obstacleBatches[0], stopSignModel);
+    setupInstanceBatch(obstacleBatches[1], coneModel);
+    setupInstanceBatch(obstacleBatches[2], barrelModel);
+    for (int i = 0; i < 4; i++) {
+        setupInstanceBatch(buildingBatches[i], buildingModels[i], &buildingInstances);
+        if (impostorShader) setupImpostor(buildingBatches[i], impostors[i]);
+    }
+    for (auto& mesh : playerCar->meshes)
+        carMaterials.push_back(Material::ForMesh(mesh));
+    grassMaterial = Material::Diffuse(grassTexture);
+    roadMaterial = Material::Diffuse(roadTexture);
+    curbMaterial = Material::Diffuse(curbTexture);
+    footpathMaterial = Material::Diffuse(footpathTexture);
+
+    // Sampler locations, once, for the program each material is drawn with
+    for (auto& m : carMaterials) m.Resolve(glState, shader);
+    grassMaterial.Resolve(glState, shader);
+    for (Material* m : { &roadMaterial, &curbMaterial, &footpathMaterial }) m->Resolve(glState, instancedShader);
+    auto resolveBatch = [&](InstanceBatch& batch) {
+        for (auto& level : batch.levels)
+            for (auto& part : level.parts) part.material.Resolve(glState, *levelShader(batch, level, instancedShader));
+    };
+    for (auto& batch : obstacleBatches) resolveBatch(batch);
+    for (auto& batch : buildingBatches) resolveBatch(batch);
+
+    gpuTimer.Init();
+    world.profiler = threaded ? &simProfiler : &profiler;
+    world.chunkStream = &chunkStream;
+
+    if (offscreen) {
+        int result = runBench(window, benchFrames, snapshotEvery, snapshotDir, shader, instancedShader, textShader);
+        finishTrace(tracePath);
+        glfwTerminate();
+        return result;
+    }
 
     resetGame();
+    keyEvents.clear();  // Pressed while loading
+    if (threaded) simThread.Start(simClock.dt, simulateTick);
 
     while (!glfwWindowShouldClose(window)) {
+        ProfileScope frameScope(&profiler, PROFILE_FRAME);
+        gpuTimer.BeginFrame(profiler);
+        lastRenderStats = renderStats;
+        renderStats = RenderStats();
+
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         processInput(window);
+        simThread.SetPaused(!gameStarted);
 
         if (!gameStarted) {
-            // Main menu rendering
-            glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-            // Title
-            std::string titleText = "CAR AVOIDANCE";
-            float titleWidth = GetTextWidth(titleText, 2.0f);
-            float titleX = (SCR_WIDTH - titleWidth) / 2.0f;
-            float titleY = SCR_HEIGHT - 120.0f;  // Slightly lower
-            RenderText(textShader, titleText, titleX, titleY, 2.0f, glm::vec3(1.0f, 1.0f, 0.0f));
-
-            // Instructions
-            std::string instrText = "Avoid obstacles and survive as long as possible!";
-            float instrWidth = GetTextWidth(instrText, 0.8f);
-            float instrX = (SCR_WIDTH - instrWidth) / 2.0f;
-            RenderText(textShader, instrText, instrX, titleY - 150.0f, 0.8f, glm::vec3(0.8f, 0.8f, 0.8f));
-
-            // Controls
-            std::string controlText1 = "A/D - Change Lane  |  C - Toggle Camera";
-            float ctrl1Width = GetTextWidth(controlText1, 0.7f);
-            float ctrl1X = (SCR_WIDTH - ctrl1Width) / 2.0f;
-            RenderText(textShader, controlText1, ctrl1X, titleY - 210.0f, 0.7f, glm::vec3(0.7f, 0.9f, 1.0f));
-
-            std::string controlText2 = "ESC - Menu (during game) / Quit (on menu)";
-            float ctrl2Width = GetTextWidth(controlText2, 0.7f);
-            float ctrl2X = (SCR_WIDTH - ctrl2Width) / 2.0f;
-            RenderText(textShader, controlText2, ctrl2X, titleY - 260.0f, 0.7f, glm::vec3(0.7f, 0.9f, 1.0f));
-
-            // Start button
-            std::string startText = "Press SPACE to Start";
-            float startWidth = GetTextWidth(startText, 1.2f);
-            float startX = (SCR_WIDTH - startWidth) / 2.0f;
-            RenderText(textShader, startText, startX, titleY - 400.0f, 1.2f, glm::vec3(0.0f, 1.0f, 0.5f));
-
-            glDisable(GL_BLEND);
+            drawMenu(textShader);
 
-            glfwSwapBuffers(window);
+            {
+                ProfileScope scope(&profiler, PROFILE_SWAP);
+                glfwSwapBuffers(window);
+            }
             glfwPollEvents();
             continue;
         }
 
-        if (!gameOver) {
-            carZ += speed * deltaTime;
-            distanceTraveled = carZ / 10.0f;
+        // Advance the simulation in fixed ticks; input is consumed by the first one
+        if (!threaded) {
+            ProfileScope scope(&profiler, PROFILE_UPDATE);
+            int ticks = simClock.advance(deltaTime);
+            for (int i = 0; i < ticks; i++) simulateTick();
+            publishSnapshot();
+        }
 
-            // Update score based on distance (10 points per meter)
-            totalScore = (int)(distanceTraveled * 10);
+        // The car is drawn between the snapshot's tick and the one before,
+        // as far along as the time since the tick (threaded) or the clock's
+        // leftover (not) says, so it moves smoothly whatever the frame rate
+        worldSnapshots.Acquire();
+        const WorldSnapshot& snap = worldSnapshots.Front();
+        float alpha = threaded ? (float)((SimThread::Clock() - snap.time) / simClock.dt) : simClock.alpha();
+        renderGame(window, snap, glm::clamp(alpha, 0.0f, 1.0f), shader, instancedShader, textShader, currentFrame);
 
-            // Increase speed by 10% every 500 points
-            int currentThreshold = (totalScore / 500) * 500;
-            if (currentThreshold > lastSpeedIncreaseScore && currentThreshold > 0) {
-                lastSpeedIncreaseScore = currentThreshold;
-                speed = baseSpeed * (1.0f + (currentThreshold / 500) * 0.1f);
-                std::cout << "Speed increased! Score: " << totalScore
-                    << " | New speed: " << speed << std::endl;
-            }
+        {
+            ProfileScope scope(&profiler, PROFILE_SWAP);
+            glfwSwapBuffers(window);
+        }
+        reportInputLatency(snap);
+        glfwPollEvents();
+    }
 
-            generateRoadIfNeeded();
-            spawnObstacles();
-            spawnBuildings();
+    simThread.Stop();
+    saveRecording();
+    finishTrace(tracePath);
 
-            // Handle lane transition
-            if (isChangingLane) {
-                laneChangeProgress += deltaTime * laneChangeSpeed;
+    glfwTerminate();
+    return 0;
+}
 
-                if (laneChangeProgress >= 1.0f) {
-                    laneChangeProgress = 1.0f;
-                    isChangingLane = false;
-                    playerLane = targetLane;
-                    carRotationY = 0.0f;
-                }
+void finishTrace(const std::string& path) {
+    if (path.empty()) return;
+    if (profiler.WriteTrace(path)) std::cout << "Trace written to " << path << std::endl;
+    else std::cout << "Failed to write trace: " << path << std::endl;
+    if (!simProfiler.IsTracing()) return;
+    std::string simPath = path + ".sim.json";  // The sim thread's sections
+    if (simProfiler.WriteTrace(simPath)) std::cout << "Trace written to " << simPath << std::endl;
+    else std::cout << "Failed to write trace: " << simPath << std::endl;
+}
 
-                // Smooth interpolation for position
-                float startX = lanes[playerLane].x;
-                float endX = lanes[targetLane].x;
-                currentCarX = startX + (endX - startX) * laneChangeProgress;
+//--------------------------------------------
 
-                // Rotation: 0 -> 15 -> 0 degrees (reduced from 30 for slower rotation)
-                float maxRotationAngle = 15.0f;
-                if (laneChangeProgress < 0.5f) {
-                    // First half: rotate from 0 to 15 degrees
-                    carRotationY = (laneChangeProgress * 2.0f) * maxRotationAngle;
-                }
-                else {
-                    // Second half: rotate from 15 back to 0 degrees
-                    carRotationY = (2.0f - laneChangeProgress * 2.0f) * maxRotationAngle;
-                }
+void queueAssets(AssetLoader& assets) {
+    assets.QueueModel(&playerCar, FileSystem::getPath("resources/project/car/Jeep_Renegade_2016.obj"));
+    assets.QueueModel(&stopSignModel, FileSystem::getPath("resources/project/StopSign/StopSign.obj"));
+    assets.QueueModel(&coneModel, FileSystem::getPath("resources/project/cone/TrafficCone.obj"));
+    assets.QueueModel(&barrelModel, FileSystem::getPath("resources/project/barrel/barrel.obj"));
+    assets.QueueModel(&buildingModels[0], FileSystem::getPath("resources/project/building/b2/b2.obj"));
+    assets.QueueModel(&buildingModels[1], FileSystem::getPath("resources/project/building/b3/b3.obj"));
+    assets.QueueModel(&buildingModels[2], FileSystem::getPath("resources/project/building/b4/b4.obj"));
+    assets.QueueModel(&buildingModels[3], FileSystem::getPath("resources/project/building/b5/b5.obj"));
+    assets.QueueTexture(&roadTexture, FileSystem::getPath("resources/project/road/3lane.jpg"));
+    assets.QueueTexture(&grassTexture, FileSystem::getPath("resources/project/grass/grass.jpg"));
+    assets.QueueTexture(&footpathTexture, FileSystem::getPath("resources/project/grass/brick1.jpg"));
+    assets.QueueTexture(&curbTexture, FileSystem::getPath("resources/project/grass/redwhite1.jpg"));
+}
 
-                // Apply direction (left is negative, right is positive)
-                if (targetLane < playerLane) {
-                    carRotationY = -carRotationY;
-                }
-            }
-            else {
-                currentCarX = lanes[playerLane].x;
-                carRotationY = 0.0f;
-            }
-        }
+void resetGame() {
+    saveRecording();  // The run that just ended, if any
+
+    if (replaying) world.seed = inputLog.Seed;
+    else if (seedPinned) world.seed = pinnedSeed;
+    else world.seed = sessionRng.Next64();
+    world.reset();
+    simClock.reset();
+    pendingInput = SimInput();
+    isFirstPersonView = false;
 
-        glm::vec3 carPos = glm::vec3(currentCarX, 0.0f, carZ);
+    if (replaying) replay.Rewind();
+    else if (!recordPath.empty()) inputLog.Clear(world.seed);
+    publishSnapshot();
+}
 
-        if (isFirstPersonView) {
-            // First-person view: camera inside/in front of the car, rotating with it
-            // Apply a reduced rotation for first-person (80% of car rotation for gentler feel)
-            float cameraRotationMultiplier = 0.8f;  // Adjust this value: lower = slower rotation
-            float rotationRad = glm::radians(-carRotationY * cameraRotationMultiplier);
+// One tick with the pending input, or the replay's. In threaded mode this
+// runs on simThread with simThread.mutex held.
+void simulateTick() {
+    ProfileScope scope(threaded ? &simProfiler : NULL, PROFILE_UPDATE);
+    SimInput input = pendingInput;
+    if (input.steerLeft || input.steerRight) {
+        consumedInputId = pendingInputId;
+        consumedInputTime = pendingInputTime;
+    }
+    uint32_t tick = (uint32_t)world.tickCount;
+    if (replaying) input = replay.InputForTick(tick);
+    else if (!recordPath.empty() && !world.gameOver) inputLog.Record(tick, input);
+    float speedBefore = world.speed;
+    world.step(simClock.dt, input);
+    pendingInput = SimInput();
+    if (world.speed != speedBefore) {
+        std::cout << "Speed increased! Score: " << world.totalScore
+            << " | New speed: " << world.speed << std::endl;
+    }
+    if (threaded) publishSnapshot();
+}
 
-            // Offset position relative to car (before rotation)
-            glm::vec3 cameraOffset(0.0f, 1.5f, 0.65f);
+void publishSnapshot() {
+    WorldSnapshot& snap = worldSnapshots.Back();
+    snap.Capture(world);
+    snap.time = SimThread::Clock();
+    snap.inputId = consumedInputId;
+    snap.inputTime = consumedInputTime;
+    worldSnapshots.Publish();
+}
 
-            // Rotate the offset around Y-axis to match car rotation
-            glm::vec3 rotatedOffset;
-            rotatedOffset.x = cameraOffset.x * cos(rotationRad) - cameraOffset.z * sin(rotationRad);
-            rotatedOffset.y = cameraOffset.y;
-            rotatedOffset.z = cameraOffset.x * sin(rotationRad) + cameraOffset.z * cos(rotationRad);
+// Input to photon, as the time from the frame loop seeing a lane key to the
+// buffer swap of the first frame drawn from a tick that consumed it
+void reportInputLatency(const WorldSnapshot& snap) {
+    if (snap.inputId == shownInputId) return;
+    shownInputId = snap.inputId;
+    double latencyUs = (SimThread::Clock() - snap.inputTime) * 1e6;
+    profiler.AddSample(PROFILE_INPUT_LATENCY, Profiler::CPU, profiler.NowUs() - latencyUs, latencyUs);
+}
 
-            camera.Position = carPos + rotatedOffset;
+void saveRecording() {
+    if (replaying || recordPath.empty() || inputLog.TickCount == 0) return;
+    if (inputLog.Save(recordPath))
+        std::cout << "Recorded " << inputLog.TickCount << " ticks to " << recordPath << std::endl;
+    else
+        std::cout << "Failed to write recording: " << recordPath << std::endl;
+    inputLog.Clear(inputLog.Seed);
+}
 
-            // Camera looks forward in the direction the car is facing
-            glm::vec3 forwardDir(0.0f, -0.1f, 1.0f);
-            glm::vec3 rotatedForward;
-            rotatedForward.x = forwardDir.x * cos(rotationRad) - forwardDir.z * sin(rotationRad);
-            rotatedForward.y = forwardDir.y;
-            rotatedForward.z = forwardDir.x * sin(rotationRad) + forwardDir.z * cos(rotationRad);
+// Value following a command-line flag; NULL if the flag is absent or is
+// directly followed by another flag
+const char* argValue(int argc, char** argv, const char* flag) {
+    for (int i = 1; i + 1 < argc; i++)
+        if (std::string(argv[i]) == flag && argv[i + 1][0] != '-') return argv[i + 1];
+    return NULL;
+}
 
-            camera.Front = glm::normalize(rotatedForward);
-        }
-        else {
-            // Third-person view: camera behind the car
-            camera.Position = carPos + glm::vec3(0.0f, 5.0f, -13.0f);
-            camera.Front = glm::normalize(glm::vec3(0.0f, 0.0f, 1.0f));
-        }
-
-        // Dark foggy atmosphere
-        glClearColor(0.25f, 0.25f, 0.27f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        shader.use();
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f),
-            (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        shader.setMat4("projection", projection);
-        shader.setMat4("view", view);
-        shader.setVec3("cameraPos", camera.Position);
-        shader.setInt("texture_diffuse1", 0);
-
-        renderObjects(shader);
-
-        // Render score text in top right corner
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        std::string scoreText = "Score: " + std::to_string(totalScore);
-        float scoreWidth = GetTextWidth(scoreText, 1.0f);
-        float textX = SCR_WIDTH - scoreWidth - 20.0f;  // Anchor to right edge, grow left
-        float textY = SCR_HEIGHT - 60.0f;   // 60 pixels from top
-        RenderText(textShader, scoreText, textX, textY, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-
-        std::string distText = std::to_string((int)distanceTraveled) + "m";
-        float distWidth = GetTextWidth(distText, 0.8f);
-        float distX = SCR_WIDTH - distWidth - 20.0f;  // Anchor to right edge, grow left
-        RenderText(textShader, distText, distX, textY - 50.0f, 0.8f, glm::vec3(0.8f, 0.8f, 0.8f));
-
-        // Render speed to bottom left
-        std::string speedText = "Speed: " + std::to_string((int)speed);
-        float speedX = 20.0f;  // 20 pixels from left edge
-        float speedY = 40.0f;  // 40 pixels from bottom
-        RenderText(textShader, speedText, speedX, speedY, 0.9f, glm::vec3(0.8f, 1.0f, 0.8f));
-
-        if (gameOver) {
-            std::string gameOverText = "GAME OVER!";
-            float gameOverWidth = GetTextWidth(gameOverText, 1.5f);
-            float gameOverX = (SCR_WIDTH - gameOverWidth) / 2.0f;
-            float gameOverY = SCR_HEIGHT / 2.0f;
-            RenderText(textShader, gameOverText, gameOverX, gameOverY, 1.5f, glm::vec3(1.0f, 0.0f, 0.0f));
-
-            std::string finalScoreText = "Final Score: " + std::to_string(totalScore);
-            float finalScoreWidth = GetTextWidth(finalScoreText, 1.0f);
-            float finalScoreX = (SCR_WIDTH - finalScoreWidth) / 2.0f;
-            RenderText(textShader, finalScoreText, finalScoreX, gameOverY - 70.0f, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-
-            std::string restartText = "Press R to Restart";
-            float restartWidth = GetTextWidth(restartText, 0.8f);
-            float restartX = (SCR_WIDTH - restartWidth) / 2.0f;
-            RenderText(textShader, restartText, restartX, gameOverY - 130.0f, 0.8f, glm::vec3(0.8f, 0.8f, 0.8f));
-
-            std::string menuText = "Press M for Main Menu";
-            float menuWidth = GetTextWidth(menuText, 0.8f);
-            float menuX = (SCR_WIDTH - menuWidth) / 2.0f;
-            RenderText(textShader, menuText, menuX, gameOverY - 180.0f, 0.8f, glm::vec3(1.0f, 0.8f, 0.0f));
-        }
-
-        glDisable(GL_BLEND);
-
-        std::string title = "Car Avoidance - Distance: " + std::to_string((int)distanceTraveled) + "m";
-        title += isFirstPersonView ? " [First-Person]" : " [Third-Person]";
-        title += " | Score: " + std::to_string(totalScore);
-        if (gameOver) title += " - GAME OVER! Final Score: " + std::to_string(totalScore) + " - Press R to Restart";
-        glfwSetWindowTitle(window, title.c_str());
+bool hasArg(int argc, char** argv, const char* flag) {
+    for (int i = 1; i < argc; i++)
+        if (std::string(argv[i]) == flag) return true;
+    return false;
+}
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+void setupHud() {
+    float centerX = SCR_WIDTH / 2.0f;
+    float titleY = SCR_HEIGHT - 120.0f;  // Slightly lower
+    hud.menu[0] = TextLabel(centerX, titleY, 2.0f, glm::vec3(1.0f, 1.0f, 0.0f), TextLabel::CENTER);
+    hud.menu[1] = TextLabel(centerX, titleY - 150.0f, 0.8f, glm::vec3(0.8f, 0.8f, 0.8f), TextLabel::CENTER);
+    hud.menu[2] = TextLabel(centerX, titleY - 210.0f, 0.7f, glm::vec3(0.7f, 0.9f, 1.0f), TextLabel::CENTER);
+    hud.menu[3] = TextLabel(centerX, titleY - 260.0f, 0.7f, glm::vec3(0.7f, 0.9f, 1.0f), TextLabel::CENTER);
+    hud.menu[4] = TextLabel(centerX, titleY - 400.0f, 1.2f, glm::vec3(0.0f, 1.0f, 0.5f), TextLabel::CENTER);
+    hud.menu[0].SetText(textRenderer, "CAR AVOIDANCE");
+    hud.menu[1].SetText(textRenderer, "Avoid obstacles and survive as long as possible!");
+    hud.menu[2].SetText(textRenderer, "A/D - Change Lane  |  C - Toggle Camera");
+    hud.menu[3].SetText(textRenderer, "ESC - Menu (during game) / Quit (on menu)");
+    hud.menu[4].SetText(textRenderer, "Press SPACE to Start");
+
+    // Score and distance are anchored to the right edge and grow left
+    float textY = SCR_HEIGHT - 60.0f;   // 60 pixels from top
+    hud.score = TextLabel(SCR_WIDTH - 20.0f, textY, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f), TextLabel::RIGHT);
+    hud.distance = TextLabel(SCR_WIDTH - 20.0f, textY - 50.0f, 0.8f, glm::vec3(0.8f, 0.8f, 0.8f), TextLabel::RIGHT);
+    hud.speed = TextLabel(20.0f, 40.0f, 0.9f, glm::vec3(0.8f, 1.0f, 0.8f));
+
+    float gameOverY = SCR_HEIGHT / 2.0f;
+    hud.gameOver = TextLabel(centerX, gameOverY, 1.5f, glm::vec3(1.0f, 0.0f, 0.0f), TextLabel::CENTER);
+    hud.finalScore = TextLabel(centerX, gameOverY - 70.0f, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f), TextLabel::CENTER);
+    hud.restart = TextLabel(centerX, gameOverY - 130.0f, 0.8f, glm::vec3(0.8f, 0.8f, 0.8f), TextLabel::CENTER);
+    hud.backToMenu = TextLabel(centerX, gameOverY - 180.0f, 0.8f, glm::vec3(1.0f, 0.8f, 0.0f), TextLabel::CENTER);
+    hud.gameOver.SetText(textRenderer, "GAME OVER!");
+    hud.restart.SetText(textRenderer, "Press R to Restart");
+    hud.backToMenu.SetText(textRenderer, "Press M for Main Menu");
+
+    // Profiler overlay, top left
+    const int overlayLines = PROFILE_SECTION_COUNT + 2;
+    for (int i = 0; i < overlayLines; i++) {
+        glm::vec3 color = (i == 0) ? glm::vec3(1.0f, 1.0f, 0.4f)
+            : (i == overlayLines - 1) ? glm::vec3(0.6f, 1.0f, 1.0f) : glm::vec3(0.9f);
+        profilerOverlay.lines[i] = TextLabel(10.0f, SCR_HEIGHT - 20.0f - i * 16.0f, 0.3f, color);
     }
+    profilerOverlay.lines[0].SetText(textRenderer, "section: cpu min/avg/p99 | gpu min/avg/p99 (ms)");
+}
 
-    glfwTerminate();
-    return 0;
+void drawMenu(Shader& textShader) {
+    glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    for (auto& label : hud.menu)
+        label.Draw(textRenderer);
+    renderStats.Add(textRenderer.Flush(textShader));
+    glDisable(GL_BLEND);
 }
 
-//--------------------------------------------
+// Re-formats only the labels whose values changed since the last frame, and
+// touches the window title only when something in it changed
+void updateHud(GLFWwindow* window, const WorldSnapshot& snap) {
+    int score = snap.totalScore;
+    int distance = (int)snap.distanceTraveled;
+    int speed = (int)snap.speed;
+    int firstPerson = isFirstPersonView ? 1 : 0;
+    int gameOver = snap.gameOver ? 1 : 0;
+    char buf[128];
+
+    if (score != hud.shownScore) {
+        snprintf(buf, sizeof(buf), "Score: %d", score);
+        hud.score.SetText(textRenderer, buf);
+        snprintf(buf, sizeof(buf), "Final Score: %d", score);
+        hud.finalScore.SetText(textRenderer, buf);
+    }
+    if (distance != hud.shownDistance) {
+        snprintf(buf, sizeof(buf), "%dm", distance);
+        hud.distance.SetText(textRenderer, buf);
+    }
+    if (speed != hud.shownSpeed) {
+        snprintf(buf, sizeof(buf), "Speed: %d", speed);
+        hud.speed.SetText(textRenderer, buf);
+    }
 
-unsigned int loadTexture(const std::string& path)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    }
-    else std::cout << "Failed to load texture: " << path << "\n";
-    stbi_image_free(data);
-    return textureID;
+    if (score != hud.shownScore || distance != hud.shownDistance
+        || firstPerson != hud.shownFirstPerson || gameOver != hud.shownGameOver) {
+        int n = snprintf(buf, sizeof(buf), "Car Avoidance - Distance: %dm%s | Score: %d",
+            distance, firstPerson ? " [First-Person]" : " [Third-Person]", score);
+        if (gameOver && n > 0 && n < (int)sizeof(buf))
+            snprintf(buf + n, sizeof(buf) - n, " - GAME OVER! Final Score: %d - Press R to Restart", score);
+        glfwSetWindowTitle(window, buf);
+    }
+
+    hud.shownScore = score;
+    hud.shownDistance = distance;
+    hud.shownSpeed = speed;
+    hud.shownFirstPerson = firstPerson;
+    hud.shownGameOver = gameOver;
 }
 
-void resetGame() {
-    playerLane = 1;
-    targetLane = 1;
-    isChangingLane = false;
-    laneChangeProgress = 0.0f;
-    currentCarX = 0.0f;
-    carRotationY = 0.0f;
-    carZ = 0.0f;
-    obstacles.clear();
-    buildings.clear();
-    distanceTraveled = 0.0f;
-    totalScore = 0;
-    speed = baseSpeed;  // Reset to base speed
-    lastSpeedIncreaseScore = 0;  // Reset speed increase tracker
-    gameOver = false;
-    isFirstPersonView = false;
+// Per-section min/avg/p99 in ms for the last Profiler::HISTORY samples, plus
+// draw call and triangle counts of the previous frame
+void drawProfilerOverlay(float now) {
+    ProfilerOverlay& o = profilerOverlay;
+    if (now >= o.nextRefresh) {
+        o.nextRefresh = now + 0.5f;
+        char buf[160];
+        for (int s = 0; s < PROFILE_SECTION_COUNT; s++) {
+            Profiler::Stats cpu;
+            if (threaded && s >= PROFILE_UPDATE && s <= PROFILE_COLLISION) {
+                // Timed on the sim thread
+                std::lock_guard<std::mutex> lock(simThread.mutex);
+                cpu = simProfiler.GetStats((ProfileSection)s, Profiler::CPU);
+            }
+            else cpu = profiler.GetStats((ProfileSection)s, Profiler::CPU);
+            Profiler::Stats gpu = profiler.GetStats((ProfileSection)s, Profiler::GPU);
+            int n = snprintf(buf, sizeof(buf), "%s: %.3f/%.3f/%.3f", PROFILE_SECTION_NAMES[s], cpu.minMs, cpu.avgMs, cpu.p99Ms);
+            if (gpu.samples > 0 && n > 0 && n < (int)sizeof(buf))
+                snprintf(buf + n, sizeof(buf) - n, " | %.3f/%.3f/%.3f", gpu.minMs, gpu.avgMs, gpu.p99Ms);
+            o.lines[s + 1].SetText(textRenderer, buf);
+        }
+        snprintf(buf, sizeof(buf), "draw calls: %d | triangles: %lld | state changes: %d | uniforms: %d | saved: %d | visible: %d | culled: %d",
+            lastRenderStats.drawCalls, lastRenderStats.triangles, lastRenderStats.stateChanges,
+            lastRenderStats.uniformWrites, lastRenderStats.redundantSkipped,
+            lastRenderStats.visibleObjects, lastRenderStats.culledObjects);
+        o.lines[PROFILE_SECTION_COUNT + 1].SetText(textRenderer, buf);
+    }
+    for (auto& line : o.lines)
+        line.Draw(textRenderer);
+}
+
+// A World with the global one's rules and settings, command line overrides
+// included, but none of its attachments, for runs of its own
+World configuredWorld() {
+    World sim = world;
+    sim.profiler = nullptr;
+    sim.chunkStream = nullptr;
+    return sim;
+}
+
+// Headless soak run: steps the simulation with no window or GL context and
+// restarts after every crash
+int runHeadless(float simSeconds) {
+    World sim = configuredWorld();
+    sim.seed = sessionRng.Next64();
+    sim.reset();
+    long long totalTicks = (long long)(simSeconds / SIM_DT);
+    int games = 1;
+    float bestDistance = 0.0f;
+
+    auto start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < totalTicks; i++) {
+        sim.step(SIM_DT, SimInput());
+        if (sim.gameOver) {
+            bestDistance = std::max(bestDistance, sim.distanceTraveled);
+            sim.seed = sessionRng.Next64();
+            sim.reset();
+            games++;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bestDistance = std::max(bestDistance, sim.distanceTraveled);
 
-    roadSegments.clear();
-    float groundLength = 1000.0f;
-    float startZ = -groundLength / 2;
-    int numSegments = int(groundLength / segmentSize) + 2;
-    for (int i = 0; i < numSegments; i++)
-        roadSegments.push_back({ startZ + i * segmentSize });
+    std::cout << "Headless: " << totalTicks << " ticks (" << simSeconds << "s simulated) in "
+        << elapsed << "s, " << (elapsed > 0.0 ? totalTicks / elapsed : 0.0) << " ticks/s\n";
+    std::cout << "Games: " << games << " | Best distance: " << (int)bestDistance << "m\n";
+    return 0;
 }
 
-void spawnObstacles() {
-    static float timer = 0.0f;
-    timer += deltaTime;
-    if (timer > 1.0f) {
-        int lane = rand() % 3;
-        int type = rand() % 3;
-        float zPos = carZ + 80.0f + rand() % 50;
-        obstacles.push_back({ lanes[lane] + glm::vec3(0.0f, 0.0f, zPos), type });
-        timer = 0.0f;
+// Headless replay: runs a recorded log to its end and prints the final state,
+// whose hash must match between builds that claim identical gameplay
+int runReplay(const std::string& path) {
+    InputLog log;
+    if (!log.Load(path)) {
+        std::cout << "Failed to load replay: " << path << std::endl;
+        return -1;
     }
+    World sim = configuredWorld();
+    sim.seed = log.Seed;
+    sim.reset();
+    InputReplay player(&log);
+
+    auto start = std::chrono::steady_clock::now();
+    while (!player.Finished((uint32_t)sim.tickCount))
+        sim.step(SIM_DT, player.InputForTick((uint32_t)sim.tickCount));
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Replay: " << sim.tickCount << " ticks in " << elapsed << "s"
+        << " | Score: " << sim.totalScore << " | Distance: " << (int)sim.distanceTraveled << "m"
+        << (sim.gameOver ? " | GAME OVER" : "") << "\n";
+    printf("State hash: %016llx\n", (unsigned long long)sim.stateHash());
+    return 0;
 }
 
-void spawnBuildings() {
-    static float timer = 0.0f;
-    timer += deltaTime;
+// Offscreen benchmark: renders into an FBO with no swap or vsync, advancing the
+// simulation a fixed 1/60 s per frame so every run draws the same frames and
+// snapshots can be image-diffed. Input comes from --replay if given; a run
+// that ends restarts immediately.
+int runBench(GLFWwindow* window, int frames, int snapshotEvery, const std::string& snapshotDir,
+    Shader& shader, Shader& instancedShader, Shader& textShader) {
+    const int width = SCR_WIDTH, height = SCR_HEIGHT;
+    unsigned int fbo, colorRbo, depthRbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glGenRenderbuffers(1, &colorRbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRbo);
+    glGenRenderbuffers(1, &depthRbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRbo);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::FRAMEBUFFER:: Bench framebuffer is not complete!" << std::endl;
+        return -1;
+    }
+    glViewport(0, 0, width, height);
 
-    if (timer > 3.0f) {
-        float zPos = carZ + 80.0f + rand() % 50;
+    gameStarted = true;
+    resetGame();
 
-        buildings.push_back({ glm::vec3(-16.0f, 0.0f, zPos), rand() % 4, true });
+    const float frameDt = 1.0f / 60.0f;
+    GLsync fences[GpuTimer::LATENCY] = {};
+    std::vector<unsigned char> pixels(width * height * 3), flipped(width * height * 3);
+    int snapshots = 0;
+    RenderStats totals;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int frame = 0; frame < frames; frame++) {
+        // At most LATENCY frames in flight, as a swap chain would allow; this
+        // also guarantees GpuTimer finds the oldest frame's queries ready
+        GLsync& fence = fences[frame % GpuTimer::LATENCY];
+        if (fence) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fence);
+        }
 
-        buildings.push_back({ glm::vec3(16.0f, 0.0f, zPos), rand() % 4, false });
+        ProfileScope frameScope(&profiler, PROFILE_FRAME);
+        gpuTimer.BeginFrame(profiler);
+        lastRenderStats = renderStats;
+        renderStats = RenderStats();
+
+        {
+            ProfileScope scope(&profiler, PROFILE_UPDATE);
+            int ticks = simClock.advance(frameDt);
+            for (int i = 0; i < ticks; i++) {
+                uint32_t tick = (uint32_t)world.tickCount;
+                world.step(simClock.dt, replaying ? replay.InputForTick(tick) : SimInput());
+            }
+        }
+        if (world.gameOver || (replaying && replay.Finished((uint32_t)world.tickCount)))
+            resetGame();
 
-        while (!buildings.empty() && buildings.front().pos.z < carZ - 100.0f)
-            buildings.erase(buildings.begin());
+        // Bench frames show the newest tick as it is, so PNG snapshots stay
+        // comparable across runs
+        publishSnapshot();
+        worldSnapshots.Acquire();
+        renderGame(window, worldSnapshots.Front(), 1.0f, shader, instancedShader, textShader, frame * frameDt);
+        totals.drawCalls += renderStats.drawCalls;
+        totals.triangles += renderStats.triangles;
+        totals.visibleObjects += renderStats.visibleObjects;
+        totals.culledObjects += renderStats.culledObjects;
+        totals.stateChanges += renderStats.stateChanges;
+        totals.uniformWrites += renderStats.uniformWrites;
+        totals.redundantSkipped += renderStats.redundantSkipped;
+
+        // Reading back stalls the pipeline, so sampled frames cost more
+        if (snapshotEvery > 0 && (frame + 1) % snapshotEvery == 0) {
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+            for (int y = 0; y < height; y++)  // GL rows are bottom-up
+                std::copy(pixels.begin() + (size_t)(height - 1 - y) * width * 3,
+                    pixels.begin() + (size_t)(height - y) * width * 3, flipped.begin() + (size_t)y * width * 3);
+            char name[64];
+            snprintf(name, sizeof(name), "/frame_%05d.png", frame + 1);
+            if (PngWriter::Write(snapshotDir + name, width, height, flipped.data())) snapshots++;
+            else std::cout << "Failed to write snapshot: " << snapshotDir + name << std::endl;
+        }
 
-        timer = 0.0f;
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    glFinish();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (GLsync fence : fences)
+        if (fence) glDeleteSync(fence);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &colorRbo);
+    glDeleteRenderbuffers(1, &depthRbo);
+    glDeleteFramebuffers(1, &fbo);
+
+    printf("Bench: %d frames at %dx%d in %.2fs | %.1f fps (%.3f ms/frame)\n",
+        frames, width, height, elapsed, frames / elapsed, elapsed * 1000.0 / frames);
+    printf("Per frame: %.1f draw calls, %.0f triangles | renderer: %s\n",
+        (double)totals.drawCalls / frames, (double)totals.triangles / frames, (const char*)glGetString(GL_RENDERER));
+    printf("Per frame: %.1f objects visible, %.1f culled\n",
+        (double)totals.visibleObjects / frames, (double)totals.culledObjects / frames);
+    printf("Per frame: %.1f binds, %.1f uniform writes, %.1f GL calls saved as redundant\n",
+        (double)totals.stateChanges / frames, (double)totals.uniformWrites / frames, (double)totals.redundantSkipped / frames);
+    printf("Chunks generated on the sim thread: %d\n", chunkStream.Misses());
+    if (snapshots > 0) printf("Snapshots: %d written to %s\n", snapshots, snapshotDir.c_str());
+    printf("%-16s %10s %10s %10s %10s\n", "section", "cpu avg", "cpu p99", "gpu avg", "gpu p99");
+    for (int s = 0; s < PROFILE_SECTION_COUNT; s++) {
+        Profiler::Stats cpu = profiler.GetStats((ProfileSection)s, Profiler::CPU);
+        Profiler::Stats gpu = profiler.GetStats((ProfileSection)s, Profiler::GPU);
+        if (cpu.runSamples == 0 && gpu.runSamples == 0) continue;
+        printf("%-16s %10.3f %10.3f", PROFILE_SECTION_NAMES[s], cpu.runAvgMs, cpu.p99Ms);
+        if (gpu.runSamples > 0) printf(" %10.3f %10.3f", gpu.runAvgMs, gpu.p99Ms);
+        printf("\n");
     }
+    printf("(avg over the whole run, p99 over the last %d samples; ms)\n", Profiler::HISTORY);
+    return 0;
 }
 
-void generateRoadIfNeeded() {
-    if (!roadSegments.empty() && carZ + segmentSize * 3 > roadSegments.back().zStart) {
-        float zNew = roadSegments.back().zStart + segmentSize;
-        roadSegments.push_back({ zNew });
-        while (!roadSegments.empty() && roadSegments.front().zStart + segmentSize < carZ - 50.0f)
-            roadSegments.pop_front();
+// Soak run: a single session that never crashes. Prints the average tick cost
+// and live entity counts per 5 simulated minutes; both should stay flat.
+int runSoak(float simSeconds) {
+    World sim = configuredWorld();
+    sim.collisionsEnabled = false;
+    sim.seed = sessionRng.Next64();
+    sim.reset();
+    const long long reportTicks = (long long)(300.0f / SIM_DT);
+    long long totalTicks = (long long)(simSeconds / SIM_DT);
+    int maxObstacles = 0;
+
+    auto blockStart = std::chrono::steady_clock::now();
+    for (long long i = 1; i <= totalTicks; i++) {
+        sim.step(SIM_DT, SimInput());
+        maxObstacles = std::max(maxObstacles, sim.obstacles.size());
+
+        if (i % reportTicks == 0 || i == totalTicks) {
+            auto now = std::chrono::steady_clock::now();
+            long long blockTicks = (i % reportTicks == 0) ? reportTicks : i % reportTicks;
+            double ns = std::chrono::duration<double, std::nano>(now - blockStart).count() / blockTicks;
+            std::cout << "t=" << (int)(i * SIM_DT) << "s  " << ns << " ns/tick"
+                << " | obstacles " << sim.obstacles.size() << " (max " << maxObstacles << "/" << ObstaclePool::CAPACITY << ")"
+                << " | buildings " << sim.buildings.size()
+                << " | segments " << sim.roadSegments.size() << "\n";
+            blockStart = now;
+        }
     }
+    return 0;
 }
 
-void processInput(GLFWwindow* window) {
-    static bool escapePressed = false;
+// Builds the same matrices both ways, so the report also checks that the
+// tables reproduce the per-object path
+int runEntityBench(int count) {
+    if (count <= 0) return 0;
+    Rng rng(1);
+    std::vector<Obstacle> obstacleList;
+    std::vector<Building> buildingList;
+    std::vector<float> obstacleX, obstacleZ, buildingX, buildingZ;
+    std::vector<int> obstacleType, buildingVariant;
+    for (int i = 0; i < count; i++) {
+        int lane = rng.NextInt(3);
+        Obstacle obs = { world.lanes[lane] + glm::vec3(0.0f, 0.0f, i * 2.0f), rng.NextInt(3), lane };
+        obstacleList.push_back(obs);
+        obstacleX.push_back(obs.pos.x);
+        obstacleZ.push_back(obs.pos.z);
+        obstacleType.push_back(obs.type);
+
+        bool left = (i & 1) == 0;
+        Building b = { glm::vec3(left ? -16.0f : 16.0f, 0.0f, i * 2.0f), rng.NextInt(4), left };
+        buildingList.push_back(b);
+        buildingX.push_back(b.pos.x);
+        buildingZ.push_back(b.pos.z);
+        buildingVariant.push_back(b.type * 2 + (left ? 1 : 0));
+    }
 
-    // ESC key behavior: exit to menu during gameplay, or quit if on menu
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS && !escapePressed) {
-        if (gameStarted && !gameOver) {
-            // In gameplay: return to menu
-            gameStarted = false;
-            resetGame();
+    std::vector<glm::mat4> objectObstacles(count), objectBuildings(count), tableObstacles(count), tableBuildings(count);
+    const int reps = 200;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++) {
+        for (int i = 0; i < count; i++) objectObstacles[i] = obstacleModelMatrix(obstacleList[i]);
+        for (int i = 0; i < count; i++) objectBuildings[i] = buildingModelMatrix(buildingList[i]);
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++) {
+        obstacleTransforms.Place(obstacleType.data(), obstacleX.data(), obstacleZ.data(), count, tableObstacles.data());
+        buildingTransforms.Place(buildingVariant.data(), buildingX.data(), buildingZ.data(), count, tableBuildings.data());
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    float maxError = 0.0f;
+    for (int i = 0; i < count; i++)
+        for (int c = 0; c < 4; c++)
+            for (int k = 0; k < 4; k++) {
+                maxError = std::max(maxError, std::fabs(objectObstacles[i][c][k] - tableObstacles[i][c][k]));
+                maxError = std::max(maxError, std::fabs(objectBuildings[i][c][k] - tableBuildings[i][c][k]));
+            }
+
+    double objectUs = std::chrono::duration<double, std::micro>(mid - start).count() / reps;
+    double tableUs = std::chrono::duration<double, std::micro>(end - mid).count() / reps;
+    printf("Model matrices for %d obstacles + %d buildings (avg of %d runs)\n", count, count, reps);
+    printf("  per object (AoS, glm): %10.1f us  %6.2f ns/entity\n", objectUs, objectUs * 1000.0 / (2.0 * count));
+    printf("  tables (SoA):          %10.1f us  %6.2f ns/entity  (%.1fx)\n", tableUs, tableUs * 1000.0 / (2.0 * count), objectUs / tableUs);
+    printf("  max difference: %g\n", maxError);
+    return 0;
+}
+
+// Edge cases of RingBuffer on a small ring, then a long random run of
+// pushes and pops checked item by item against a std::deque. Returns the
+// number of failed checks.
+int checkRingBuffer() {
+    int failures = 0;
+    auto check = [&](bool ok, const char* what) {
+        if (!ok) {
+            printf("  RingBuffer check failed: %s\n", what);
+            failures++;
+        }
+    };
+    // Every live item, through operator[], the iterators and spans(), in order
+    auto matches = [](const RingBuffer<int, 8>& ring, const std::deque<int>& expected) {
+        if (ring.size() != (int)expected.size() || ring.empty() != expected.empty()) return false;
+        int i = 0;
+        for (int v : ring)
+            if (v != expected[i++]) return false;
+        const int* data[2];
+        int sizes[2];
+        int spans = ring.spans(data, sizes);
+        if (spans != (expected.empty() ? 0 : sizes[1] > 0 ? 2 : 1) || sizes[0] + sizes[1] != ring.size()) return false;
+        for (int s = 0, k = 0; s < spans; s++)
+            for (int j = 0; j < sizes[s]; j++, k++)
+                if (data[s][j] != expected[k] || ring[k] != expected[k]) return false;
+        return expected.empty() || (ring.front() == expected.front() && ring.back() == expected.back());
+    };
+
+    RingBuffer<int, 8> ring;
+    std::deque<int> expected;
+    const int* data[2];
+    int sizes[2];
+    check(ring.empty() && ring.spans(data, sizes) == 0, "new ring is empty");
+
+    // Full, then drained, three times over so the start moves round
+    for (int cycle = 0; cycle < 3; cycle++) {
+        for (int i = 0; i < 8; i++) {
+            ring.push_back(cycle * 10 + i);
+            expected.push_back(cycle * 10 + i);
         }
-        else if (!gameStarted) {
-            // On main menu: quit application
-            glfwSetWindowShouldClose(window, true);
+        check(ring.full() && matches(ring, expected), "full ring");
+        ring.pop_front(3);
+        expected.erase(expected.begin(), expected.begin() + 3);
+        check(matches(ring, expected), "partly drained ring");
+        ring.pop_front(0);
+        check(matches(ring, expected), "pop_front(0)");
+        ring.pop_front(5);
+        expected.clear();
+        check(ring.empty() && matches(ring, expected), "drained ring");
+        ring.push_back(-1);  // Shifts the next cycle's start by one
+        ring.pop_front();
+    }
+
+    // Wrapped: six in, five out, six in leaves 7 items from slot 5
+    ring.clear();
+    expected.clear();
+    for (int i = 0; i < 6; i++) { ring.push_back(i); expected.push_back(i); }
+    ring.pop_front(5);
+    expected.erase(expected.begin(), expected.begin() + 5);
+    for (int i = 6; i < 12; i++) { ring.push_back(i); expected.push_back(i); }
+    check(ring.spans(data, sizes) == 2 && sizes[0] == 3 && sizes[1] == 4, "wrapped ring gives two spans");
+    check(matches(ring, expected), "wrapped ring");
+    // Live items ending exactly at the array's end are still one span
+    ring.clear();
+    for (int i = 0; i < 8; i++) ring.push_back(i);
+    ring.pop_front(4);
+    check(ring.spans(data, sizes) == 1 && sizes[0] == 4 && data[0][3] == 7, "items up to the array end are one span");
+    ring.clear();
+    check(ring.empty() && !ring.full() && ring.spans(data, sizes) == 0, "clear()");
+
+    // Random pushes and pops
+    Rng rng(3);
+    expected.clear();
+    int next = 0;
+    bool same = true;
+    for (int op = 0; op < 100000 && same; op++) {
+        if (rng.NextInt(2) && !ring.full()) {
+            ring.push_back(next);
+            expected.push_back(next++);
         }
-        escapePressed = true;
+        else {
+            int n = rng.NextInt(ring.size() + 1);
+            ring.pop_front(n);
+            expected.erase(expected.begin(), expected.begin() + n);
+        }
+        same = matches(ring, expected);
     }
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_RELEASE) escapePressed = false;
+    check(same, "random pushes and pops match std::deque");
+    return failures;
+}
 
-    static bool leftPressed = false, rightPressed = false, restartPressed = false, cameraPressed = false;
+// The World's streaming pattern at its worst: every item is pushed at the
+// back of a window already holding BuildingList::CAPACITY items, and the
+// oldest one retired from the front. Each container sums the items it
+// retires, so the report also checks that they agree.
+int runContainerBench(int count) {
+    int failures = checkRingBuffer();
+    printf("RingBuffer checks %s\n", failures ? "FAILED" : "passed");
+    if (failures || count <= 0) return failures ? 1 : 0;
+    const int window = BuildingList::CAPACITY;
+    double sums[3] = {};
+    auto time = [&](auto&& run) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
 
-    // Start game from menu
-    static bool startPressed = false;
-    if (!gameStarted && glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && !startPressed) {
-        gameStarted = true;
-        startPressed = true;
+    std::vector<float> vec;
+    double vectorMs = time([&] {
+        for (int i = 0; i < count; i++) {
+            if ((int)vec.size() == window) { sums[0] += vec.front(); vec.erase(vec.begin()); }
+            vec.push_back((float)i);
+        }
+    });
+    std::deque<float> deq;
+    double dequeMs = time([&] {
+        for (int i = 0; i < count; i++) {
+            if ((int)deq.size() == window) { sums[1] += deq.front(); deq.pop_front(); }
+            deq.push_back((float)i);
+        }
+    });
+    static RingBuffer<float, BuildingList::CAPACITY> ring;
+    double ringMs = time([&] {
+        for (int i = 0; i < count; i++) {
+            if (ring.full()) { sums[2] += ring.front(); ring.pop_front(); }
+            ring.push_back((float)i);
+        }
+    });
+
+    printf("Streaming %d items through a %d-item window\n", count, window);
+    printf("  vector (erase front): %9.2f ms  %6.2f ns/item\n", vectorMs, vectorMs * 1e6 / count);
+    printf("  std::deque:           %9.2f ms  %6.2f ns/item  (%.1fx)\n", dequeMs, dequeMs * 1e6 / count, vectorMs / dequeMs);
+    printf("  RingBuffer:           %9.2f ms  %6.2f ns/item  (%.1fx)\n", ringMs, ringMs * 1e6 / count, vectorMs / ringMs);
+    printf("  results %s\n", sums[0] == sums[1] && sums[1] == sums[2] ? "match" : "DIFFER");
+    return sums[0] == sums[1] && sums[1] == sums[2] ? 0 : 1;
+}
+
+// Taps of random length (some shorter than a frame) at random times, played
+// through the game's own input path at 60 frames per second: queueKeyEvent()
+// as the key callback would, processInput() and simulateTick() as the frame
+// loop does. Keys are fed the two ways the game could read them: the key
+// state polled at the start of each frame (a press queued only if the key is
+// down then), or every press since the last frame. Latency runs from the key
+// going down to the tick where the lane change starts, in ticks. Both ways
+// are bound to the frame rate, since GLFW only delivers events when polled;
+// events just miss no taps.
+int runInputBench(int taps) {
+    if (taps <= 0) return 0;
+    const double frameDt = 1.0 / 60.0;
+    Rng rng(7);
+    std::vector<double> down(taps), up(taps);
+    double t = 0.5;
+    for (int i = 0; i < taps; i++) {
+        t += 0.6 + rng.NextInt(400) / 1000.0;  // Past the 0.5 s lane change
+        down[i] = t;
+        up[i] = t + (5 + rng.NextInt(60)) / 1000.0;
     }
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_RELEASE) startPressed = false;
 
-    // Return to menu from game over
-    static bool menuPressed = false;
-    if (gameOver && glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS && !menuPressed) {
-        gameStarted = false;
+    // The ticks announce every speed-up; the bench's runs aren't worth keeping
+    std::streambuf* out = std::cout.rdbuf(NULL);
+    recordPath.clear();
+    world.collisionsEnabled = false;
+    gameStarted = true;
+
+    const char* names[2] = { "polled per frame", "key events" };
+    int seen[2] = {};
+    double totalTicks[2] = {}, worstTicks[2] = {};
+    for (int mode = 0; mode < 2; mode++) {
         resetGame();
-        menuPressed = true;
+        keyEvents.clear();
+        int next = 0;
+        bool polled = false;  // Whether polling has caught tap `next` down
+        uint64_t lastId = consumedInputId;
+        for (double frame = frameDt; next < taps || !keyEvents.empty() || pendingInputId != consumedInputId; frame += frameDt) {
+            if (mode == 0) {
+                // What glfwGetKey would say now; a tap that went down and up
+                // since the last poll is never seen. Stamped with the real
+                // key-down so both ways measure the same latency.
+                while (next < taps && up[next] <= frame) {
+                    next++;
+                    polled = false;
+                }
+                if (next < taps && down[next] <= frame && !polled) {
+                    queueKeyEvent(world.playerLane < 2 ? GLFW_KEY_A : GLFW_KEY_D, GLFW_PRESS, down[next]);
+                    polled = true;
+                }
+            }
+            else {
+                for (; next < taps && down[next] <= frame; next++) {
+                    queueKeyEvent(world.playerLane < 2 ? GLFW_KEY_A : GLFW_KEY_D, GLFW_PRESS, down[next]);
+                    queueKeyEvent(world.playerLane < 2 ? GLFW_KEY_A : GLFW_KEY_D, GLFW_RELEASE, up[next]);
+                }
+            }
+
+            processInput(NULL);
+            int ticks = simClock.advance((float)frameDt);
+            for (int i = 0; i < ticks; i++) {
+                simulateTick();
+                if (consumedInputId != lastId && world.isChangingLane) {
+                    double latency = (frame - consumedInputTime) / SIM_DT;  // The ticks run at the frame's start
+                    totalTicks[mode] += latency;
+                    worstTicks[mode] = std::max(worstTicks[mode], latency);
+                    seen[mode]++;
+                    lastId = consumedInputId;
+                }
+            }
+        }
     }
-    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_RELEASE) menuPressed = false;
+    std::cout.rdbuf(out);
 
-    // Camera toggle
-    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !cameraPressed) {
-        isFirstPersonView = !isFirstPersonView;
-        cameraPressed = true;
+    for (int mode = 0; mode < 2; mode++)
+        printf("%-17s %d/%d taps registered, key-down to lane change %.2f ticks avg, %.2f worst\n",
+            names[mode], seen[mode], taps, seen[mode] ? totalTicks[mode] / seen[mode] : 0.0, worstTicks[mode]);
+    return 0;
+}
+
+// One game of a bot batch
+struct BotGame {
+    float distance;
+    long long ticks;
+    bool capped;  // Still running at the time limit
+};
+
+// Plays `games` headless games with the bot on every core, each from a seed
+// of its own, and reports how far they got. `rules` holds the tuning under
+// test (speeds, spacing); its state is reset for every game.
+int runBots(int games, Bot::Kind kind, const World& rules, float maxSeconds, int threads) {
+    if (games <= 0) return 0;
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, games);
+    uint64_t baseSeed = seedPinned ? pinnedSeed : sessionRng.Next64();
+    long long maxTicks = (long long)(maxSeconds / SIM_DT);
+
+    std::vector<BotGame> results(games);
+    std::atomic<int> nextGame{ 0 };
+    auto play = [&] {
+        World sim = rules;
+        sim.profiler = nullptr;
+        sim.chunkStream = nullptr;
+        for (int g; (g = nextGame.fetch_add(1, std::memory_order_relaxed)) < games;) {
+            Rng seeds(baseSeed, (uint64_t)g);  // Same game whatever thread plays it
+            sim.seed = seeds.Next64();
+            sim.reset();
+            Bot bot(kind, seeds.Next64());
+            while (!sim.gameOver && (long long)sim.tickCount < maxTicks)
+                sim.step(SIM_DT, bot.Decide(sim));
+            results[g] = { sim.distanceTraveled, (long long)sim.tickCount, !sim.gameOver };
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) workers.emplace_back(play);
+    for (std::thread& t : workers) t.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<float> distances(games);
+    long long totalTicks = 0;
+    int capped = 0;
+    double sum = 0.0;
+    for (int i = 0; i < games; i++) {
+        distances[i] = results[i].distance;
+        totalTicks += results[i].ticks;
+        capped += results[i].capped;
+        sum += results[i].distance;
+    }
+    std::sort(distances.begin(), distances.end());
+    auto percentile = [&](float p) { return distances[std::min(games - 1, (int)(games * p))]; };
+
+    printf("%d %s games on %d threads (seed %llu): baseSpeed %.1f, laneChangeSpeed %.1f, segmentSize %.1f, firstObstacleZ %.1f\n",
+        games, Bot::KindName(kind), threads, (unsigned long long)baseSeed,
+        rules.baseSpeed, rules.laneChangeSpeed, rules.segmentSize, rules.firstObstacleZ);
+    printf("  %lld ticks in %.2f s, %.0f ticks/s\n", totalTicks, elapsed, elapsed > 0.0 ? totalTicks / elapsed : 0.0);
+    printf("  distance (m): min %.0f | p10 %.0f | p50 %.0f | p90 %.0f | max %.0f | mean %.0f\n",
+        distances.front(), percentile(0.1f), percentile(0.5f), percentile(0.9f), distances.back(), sum / games);
+    if (capped > 0)
+        printf("  %d games still running after %.0f s (counted at that distance)\n", capped, maxSeconds);
+
+    // Histogram in ten equal bins up to the longest run
+    const int BINS = 10, BAR = 40;
+    int counts[BINS] = {};
+    float width = std::max(distances.back(), 1.0f) / BINS;
+    for (float d : distances) counts[std::min(BINS - 1, (int)(d / width))]++;
+    int most = *std::max_element(counts, counts + BINS);
+    for (int i = 0; i < BINS; i++) {
+        printf("  %6.0f-%-6.0f %6d %s\n", i * width, (i + 1) * width, counts[i],
+            std::string((size_t)((long long)counts[i] * BAR / most), '#').c_str());
     }
-    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE) cameraPressed = false;
+    return 0;
+}
 
-    // Only allow lane change if not currently changing lanes
-    if (!isChangingLane && !gameOver) {
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS && !leftPressed) {
-            if (playerLane > 0) {
-                targetLane = playerLane - 1;
-                isChangingLane = true;
-                laneChangeProgress = 0.0f;
-            }
-            leftPressed = true;
+// The game's hot paths one at a time, with no window or GL context: the
+// model matrices renderObjects() builds, HUD text layout, and World ticks at
+// scaled view distances and session lengths, their collision, road and
+// spawn costs read from the World's own profiler sections
+int runMicroBench(const std::string& jsonPath, const std::string& filter, const char* executable) {
+    MicroBench bench;
+    bench.Filter = filter;
+    bench.PrintHeader();
+
+    // renderObjects(): through the transform tables as drawn, and per object
+    for (int count : { 64, 512, 4096 }) {
+        Rng rng(1);
+        std::vector<Obstacle> obstacleList;
+        std::vector<float> obstacleX, obstacleZ, buildingX, buildingZ;
+        std::vector<int> obstacleType, buildingVariant;
+        for (int i = 0; i < count; i++) {
+            int lane = rng.NextInt(3);
+            obstacleList.push_back({ world.lanes[lane] + glm::vec3(0.0f, 0.0f, i * 2.0f), rng.NextInt(3), lane });
+            obstacleX.push_back(obstacleList.back().pos.x);
+            obstacleZ.push_back(obstacleList.back().pos.z);
+            obstacleType.push_back(obstacleList.back().type);
+            bool left = (i & 1) == 0;
+            buildingX.push_back(left ? -16.0f : 16.0f);
+            buildingZ.push_back(i * 2.0f);
+            buildingVariant.push_back(rng.NextInt(4) * 2 + (left ? 1 : 0));
         }
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_RELEASE) leftPressed = false;
+        std::vector<glm::mat4> matrices(count);
+        std::string n = "/" + std::to_string(count);
+        bench.Run("render/obstacleTransforms" + n, [&](long long iterations) {
+            for (long long i = 0; i < iterations; i++) {
+                obstacleTransforms.Place(obstacleType.data(), obstacleX.data(), obstacleZ.data(), count, matrices.data());
+                KeepValue(matrices[0]);
+            }
+        }, count);
+        bench.Run("render/buildingTransforms" + n, [&](long long iterations) {
+            for (long long i = 0; i < iterations; i++) {
+                buildingTransforms.Place(buildingVariant.data(), buildingX.data(), buildingZ.data(), count, matrices.data());
+                KeepValue(matrices[0]);
+            }
+        }, count);
+        bench.Run("render/obstacleModelMatrix" + n, [&](long long iterations) {
+            for (long long i = 0; i < iterations; i++) {
+                for (int j = 0; j < count; j++) matrices[j] = obstacleModelMatrix(obstacleList[j]);
+                KeepValue(matrices[0]);
+            }
+        }, count);
+    }
 
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS && !rightPressed) {
-            if (playerLane < 2) {
-                targetLane = playerLane + 1;
-                isChangingLane = true;
-                laneChangeProgress = 0.0f;
+    // Text layout against glyph metrics shaped like the 48px atlas instead
+    // of a loaded font, so nothing needs FreeType or GL
+    TextRenderer text;
+    for (int c = 0; c < 128; c++) {
+        TextRenderer::Glyph& g = text.Glyphs[c];
+        g.Size = glm::ivec2(18 + c % 9, 30 + c % 7);
+        g.Bearing = glm::ivec2(1 + c % 3, 30);
+        g.Advance = 20.0f + c % 9;
+        g.UvMin = glm::vec2((c % 16) / 16.0f, (c / 16) / 8.0f);
+        g.UvMax = g.UvMin + glm::vec2(1.0f / 16.0f, 1.0f / 8.0f);
+    }
+    for (int length : { 16, 256 }) {
+        std::string line;
+        for (int i = 0; i < length; i++) line += (char)('0' + i % 75);
+        std::vector<float> quads;
+        std::string n = "/" + std::to_string(length);
+        bench.Run("text/GetTextWidth" + n, [&](long long iterations) {
+            for (long long i = 0; i < iterations; i++) {
+                float width = text.GetTextWidth(line, 0.5f);
+                KeepValue(width);
+            }
+        }, length);
+        bench.Run("text/RenderText" + n, [&](long long iterations) {
+            for (long long i = 0; i < iterations; i++) {
+                quads.clear();
+                text.BuildText(line, 10.0f, 10.0f, 0.5f, glm::vec3(1.0f), quads);
+                KeepValue(quads[0]);
+            }
+        }, length);
+    }
+
+    // World ticks for a fixed session under the configured rules, each timed
+    // as the update section. Crashes start a new run, outside the timings. Section times include the
+    // profiler's own clock reads.
+    auto session = [&](const std::string& suffix, World& sim, float seconds, Bot* bot, bool weave) {
+        const ProfileSection sections[] = { PROFILE_UPDATE, PROFILE_COLLISION, PROFILE_ROAD_GEN, PROFILE_SPAWN_OBSTACLES, PROFILE_SPAWN_BUILDINGS };
+        const char* names[] = { "world/step", "world/collision", "world/roadGen", "world/spawnObstacles", "world/spawnBuildings" };
+        bool wanted = false;
+        for (const char* name : names) wanted = wanted || bench.Wants(name + suffix);
+        if (!wanted) return;
+
+        Profiler profile;
+        sim.profiler = &profile;
+        sim.seed = 1;
+        sim.reset();
+        long long ticks = std::llround(seconds / SIM_DT);
+        for (long long i = 0; i < ticks; i++) {
+            if (sim.gameOver) {
+                sim.seed++;
+                sim.reset();
             }
-            rightPressed = true;
+            SimInput input;
+            if (bot) input = bot->Decide(sim);
+            if (weave) {
+                if (sim.playerLane < 2) input.steerLeft = true;
+                else input.steerRight = true;
+            }
+            ProfileScope scope(&profile, PROFILE_UPDATE);
+            sim.step(SIM_DT, input);
+        }
+        for (int s = 0; s < 5; s++) {
+            Profiler::Stats stats = profile.GetStats(sections[s], Profiler::CPU);
+            if (stats.runSamples > 0)
+                bench.Record(names[s] + suffix, stats.runSamples, stats.runAvgMs * 1e6 * stats.runSamples, s == 0 ? 1 : 0);
         }
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_RELEASE) rightPressed = false;
+    };
+
+    // Scaled entity counts: the greedy bot dodging with collisions on, with
+    // more road (and so more obstacles and buildings) loaded ahead
+    for (int chunks : { 15, 127, MAX_ROAD_CHUNKS - 3 }) {
+        World sim = configuredWorld();
+        sim.roadChunksAhead = chunks;
+        Bot bot(Bot::GREEDY, 1);
+        session("/chunks:" + std::to_string(chunks), sim, 120.0f, &bot, false);
     }
-    else {
-        // Reset key states
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_RELEASE) leftPressed = false;
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_RELEASE) rightPressed = false;
+    // Long sessions: one uninterrupted run, as far out as an hour of driving
+    for (int seconds : { 60, 3600 }) {
+        World sim = configuredWorld();
+        sim.collisionsEnabled = false;
+        session("/soak/seconds:" + std::to_string(seconds), sim, (float)seconds, nullptr, false);
+    }
+    // Lane-change interpolation: the same ticks driving straight and
+    // changing lanes all the time
+    for (int weave = 0; weave < 2; weave++) {
+        World sim = configuredWorld();
+        sim.collisionsEnabled = false;
+        session(weave ? "/laneChange:weaving" : "/laneChange:straight", sim, 60.0f, nullptr, weave == 1);
     }
 
-    if (gameOver && glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !restartPressed) {
-        resetGame();
-        gameStarted = true;
-        restartPressed = true;
+    if (!jsonPath.empty()) {
+        if (!bench.WriteJson(jsonPath, executable)) {
+            std::cout << "Failed to write " << jsonPath << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << jsonPath << std::endl;
     }
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE) restartPressed = false;
+    return 0;
 }
 
-void framebuffer_size_callback(GLFWwindow* window, int width, int height) { glViewport(0, 0, width, height); }
+void processInput(GLFWwindow* window) {
+    // Holds off the sim thread's next tick while the World is read and changed
+    std::unique_lock<std::mutex> simLock(simThread.mutex, std::defer_lock);
+    if (threaded) simLock.lock();
+
+    // Only presses do anything; releases and key repeats are ignored
+    while (!keyEvents.empty()) {
+        KeyEvent e = keyEvents.front();
+        keyEvents.pop_front();
+        if (e.action != GLFW_PRESS) continue;
+
+        switch (e.key) {
+        case GLFW_KEY_ESCAPE:
+            // Exit to menu during gameplay, or quit if on menu
+            if (gameStarted && !world.gameOver) {
+                gameStarted = false;
+                resetGame();
+            }
+            else if (!gameStarted) glfwSetWindowShouldClose(window, true);
+            break;
+        case GLFW_KEY_SPACE:  // Start game from menu
+            gameStarted = true;
+            break;
+        case GLFW_KEY_M:  // Return to menu from game over
+            if (world.gameOver) {
+                gameStarted = false;
+                resetGame();
+            }
+            break;
+        case GLFW_KEY_R:  // Restart after game over
+            if (world.gameOver) {
+                resetGame();
+                gameStarted = true;
+            }
+            break;
+        case GLFW_KEY_C:
+            isFirstPersonView = !isFirstPersonView;
+            break;
+        case GLFW_KEY_F3:
+            profilerOverlay.visible = !profilerOverlay.visible;
+            profilerOverlay.nextRefresh = 0.0f;
+            break;
+        case GLFW_KEY_A:
+        case GLFW_KEY_D:
+            // Only allow lane change if not currently changing lanes
+            if (!gameStarted || world.isChangingLane || world.gameOver) break;
+            if (e.key == GLFW_KEY_D) pendingInput.steerRight = true;
+            else pendingInput.steerLeft = true;
+            pendingInputId++;
+            pendingInputTime = e.time;
+            break;
+        }
+    }
+}
 
-void renderObjects(Shader& shader) {
-    glm::mat4 model;
+// Draws one gameplay frame (scene and HUD) into the bound framebuffer
+void renderGame(GLFWwindow* window, const WorldSnapshot& snap, float alpha,
+    Shader& shader, Shader& instancedShader, Shader& textShader, float now) {
+    glm::vec3 carPos = snap.CarPosition(alpha);
 
-    // Car with rotation
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(currentCarX, 0.0f, carZ));
-    model = glm::rotate(model, glm::radians(carRotationY), glm::vec3(0.0f, 1.0f, 0.0f));
-    shader.setMat4("model", model);
-    playerCar->Draw(shader);
+    if (isFirstPersonView) {
+        // First-person view: camera inside/in front of the car, rotating with it
+        // Apply a reduced rotation for first-person (80% of car rotation for gentler feel)
+        float cameraRotationMultiplier = 0.8f;  // Adjust this value: lower = slower rotation
+        float rotationRad = glm::radians(-snap.CarRotationY(alpha) * cameraRotationMultiplier);
 
-    // Grass Ground
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, grassTexture);
-    shader.setInt("texture_diffuse1", 0);
-    glm::mat4 grassModel = glm::mat4(1.0f);
-    grassModel = glm::translate(grassModel, glm::vec3(0.0f, -0.01f, carZ));
-    shader.setMat4("model", grassModel);
-    glBindVertexArray(grassVAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        // Offset position relative to car (before rotation)
+        glm::vec3 cameraOffset(0.0f, 1.5f, 0.65f);
+
+        // Rotate the offset around Y-axis to match car rotation
+        glm::vec3 rotatedOffset;
+        rotatedOffset.x = cameraOffset.x * cos(rotationRad) - cameraOffset.z * sin(rotationRad);
+        rotatedOffset.y = cameraOffset.y;
+        rotatedOffset.z = cameraOffset.x * sin(rotationRad) + cameraOffset.z * cos(rotationRad);
+
+        camera.Position = carPos + rotatedOffset;
 
-    // Footpath (both sides)
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, footpathTexture);
-    shader.setInt("texture_diffuse1", 0);
-    for (auto& seg : roadSegments) {
-        glm::mat4 fmodel = glm::mat4(1.0f);
-        fmodel = glm::translate(fmodel, glm::vec3(0.0f, 0.0f, seg.zStart));
-        shader.setMat4("model", fmodel);
+        // Camera looks forward in the direction the car is facing
+        glm::vec3 forwardDir(0.0f, -0.1f, 1.0f);
+        glm::vec3 rotatedForward;
+        rotatedForward.x = forwardDir.x * cos(rotationRad) - forwardDir.z * sin(rotationRad);
+        rotatedForward.y = forwardDir.y;
+        rotatedForward.z = forwardDir.x * sin(rotationRad) + forwardDir.z * cos(rotationRad);
 
-        glBindVertexArray(footpathVAO);
-        glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_INT, 0);
+        camera.Front = glm::normalize(rotatedForward);
+    }
+    else {
+        // Third-person view: camera behind the car
+        camera.Position = carPos + glm::vec3(0.0f, 5.0f, -13.0f);
+        camera.Front = glm::normalize(glm::vec3(0.0f, 0.0f, 1.0f));
     }
 
-    // ----- CURB (red write) -----
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, curbTexture);
-    shader.setInt("texture_diffuse1", 0);
-    for (auto& seg : roadSegments) {
-        glm::mat4 cmodel = glm::mat4(1.0f);
-        cmodel = glm::translate(cmodel, glm::vec3(0.0f, 0.0f, seg.zStart));
-        shader.setMat4("model", cmodel);
-        glBindVertexArray(curbVAO);
-        glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_INT, 0);
+    // Dark foggy atmosphere
+    glClearColor(0.25f, 0.25f, 0.27f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glm::mat4 projection = glm::perspective(glm::radians(CAMERA_FOV),
+        (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+    glm::mat4 view = camera.GetViewMatrix();
+    frameUniforms.Update(projection, view, camera.Position);
+
+    // Programs without the Frame block (and fragment stages reading
+    // cameraPos) still take the camera as plain uniforms
+    glState.Reset();
+    for (Shader* s : { &shader, &instancedShader, buildingShader, impostorShader }) {
+        if (!s) continue;
+        const GlState::Common& u = glState.Uniforms(*s);
+        glState.SetMat4(*s, u.projection, projection);
+        glState.SetMat4(*s, u.view, view);
+        glState.SetVec3(*s, u.cameraPos, camera.Position);
     }
 
-    // Road
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, roadTexture);
-    shader.setInt("texture_diffuse1", 0);
-    for (auto& seg : roadSegments) {
-        glm::mat4 m = glm::mat4(1.0f);
-        m = glm::translate(m, glm::vec3(0.0f, 0.01f, seg.zStart));
-        shader.setMat4("model", m);
-        glBindVertexArray(roadVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    {
+        ProfileScope scope(&profiler, PROFILE_RENDER);
+        renderObjects(snap, alpha, shader, instancedShader, projection * view);
     }
 
-    // Obstacles
-    for (auto& obs : obstacles) {
-        glm::vec3 carPos = glm::vec3(currentCarX, 0.0f, carZ);
-        if (glm::distance(obs.pos, carPos) < 2.0f) gameOver = true;
+    // Render score text in top right corner
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, obs.pos);
+    updateHud(window, snap);
+    hud.score.Draw(textRenderer);
+    hud.distance.Draw(textRenderer);
+    hud.speed.Draw(textRenderer);
 
-        if (obs.type == 0) { // StopSign
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(1.0f));
-        }
-        else if (obs.type == 1) { // Cone
-            model = glm::scale(model, glm::vec3(0.6f));
-        }
-        else if (obs.type == 2) { // Barrel
-            model = glm::scale(model, glm::vec3(2.0f));
+    if (snap.gameOver) {
+        hud.gameOver.Draw(textRenderer);
+        hud.finalScore.Draw(textRenderer);
+        hud.restart.Draw(textRenderer);
+        hud.backToMenu.Draw(textRenderer);
+    }
+
+    if (profilerOverlay.visible)
+        drawProfilerOverlay(now);
+
+    {
+        GpuScope scope(&profiler, &gpuTimer, PROFILE_TEXT);
+        renderStats.Add(textRenderer.Flush(textShader));
+    }
+    glDisable(GL_BLEND);
+}
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height) { glViewport(0, 0, width, height); }
+
+void key_callback(GLFWwindow*, int key, int, int action, int) {
+    queueKeyEvent(key, action, SimThread::Clock());
+}
+
+void queueKeyEvent(int key, int action, double time) {
+    if (keyEvents.full()) return;  // Far more than a frame's worth; drop the newest
+    keyEvents.push_back({ key, action, time });
+}
+
+void renderObjects(const WorldSnapshot& snap, float alpha, Shader& shader, Shader& instancedShader, const glm::mat4& viewProjection) {
+    renderQueue.Clear();
+
+    // Car with rotation
+    glm::vec3 carPos = snap.CarPosition(alpha);
+    glm::mat4 carModel = glm::mat4(1.0f);
+    carModel = glm::translate(carModel, carPos);
+    carModel = glm::rotate(carModel, glm::radians(snap.CarRotationY(alpha)), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // Visibility of everything but the grass, which always fills the view
+    size_t roadFirst = 1;
+    size_t obstacleFirst = roadFirst + snap.roadSegments.size();
+    size_t buildingFirst;
+    {
+        ProfileScope scope(&profiler, PROFILE_CULL);
+        syncBuildings(snap.buildings);
+        sceneBounds.Clear();
+        sceneBounds.AddTransformed(carModel, playerCar->boundsMin, playerCar->boundsMax);
+        for (auto& seg : snap.roadSegments)
+            sceneBounds.Add(glm::vec3(-11.0f, 0.0f, seg.zStart), glm::vec3(11.0f, 0.2f, seg.zStart + snap.segmentSize));
+        const ObstaclePool& obstacles = snap.obstacles;
+        obstacleMatrices.resize(obstacles.size());
+        // The pool's rings move in step, so their spans line up
+        const int* types[2]; const float* xs[2]; const float* zs[2];
+        int sizes[2];
+        int spans = obstacles.type.spans(types, sizes);
+        obstacles.x.spans(xs, sizes);
+        obstacles.z.spans(zs, sizes);
+        for (int s = 0, placed = 0; s < spans; placed += sizes[s++])
+            obstacleTransforms.Place(types[s], xs[s], zs[s], sizes[s], obstacleMatrices.data() + placed);
+        for (int i = 0; i < obstacles.size(); i++) {
+            const LoadedModel* model = obstacleBatches[obstacles.type[i]].model;
+            sceneBounds.AddTransformed(obstacleMatrices[i], model->boundsMin, model->boundsMax);
         }
 
-        shader.setMat4("model", model);
+        buildingFirst = sceneBounds.Size();
+        for (const BakedBuilding& b : bakedBuildings)
+            sceneBounds.Add(b.boundsMin, b.boundsMax);
 
-        if (obs.type == 0) stopSignModel->Draw(shader);
-        else if (obs.type == 1) coneModel->Draw(shader);
-        else barrelModel->Draw(shader);
+        viewFrustum.Extract(viewProjection);
+        int visible = viewFrustum.Cull(sceneBounds, sceneVisible);
+        renderStats.visibleObjects += visible;
+        renderStats.culledObjects += (int)sceneBounds.Size() - visible;
     }
 
-    // Buildings
-    for (auto& b : buildings) {
-        glm::mat4 model = glm::mat4(1.0f);
-        glm::vec3 pos = b.pos;
+    {
+        ProfileScope scope(&profiler, PROFILE_CAR);
+        if (sceneVisible[0]) {
+            for (size_t i = 0; i < playerCar->meshes.size(); i++) {
+                const Mesh& mesh = playerCar->meshes[i];
+                renderQueue.Add(&shader, &carMaterials[i], mesh.VAO, (int)mesh.indices.size(), carModel);
+            }
+        }
+    }
+
+    // Grass Ground
+    {
+        ProfileScope scope(&profiler, PROFILE_GRASS);
+        glm::mat4 grassModel = glm::mat4(1.0f);
+        grassModel = glm::translate(grassModel, glm::vec3(0.0f, -0.01f, carPos.z));
+        renderQueue.Add(&shader, &grassMaterial, grassVAO, 6, grassModel);
+    }
 
-        if (b.leftSide) {
-            if (b.type == 0) pos.x -= 2.5f;
-            else if (b.type == 1) pos.x -= 3.0f;
-            else if (b.type == 2) pos.x -= 3.8f;
-            else if (b.type == 3) pos.x -= 5.0f;
+    // Road strip: segment matrices are only re-uploaded when the set of visible
+    // segments changes, then footpath, curb and road take one draw each
+    {
+        ProfileScope scope(&profiler, PROFILE_ROAD);
+        visibleRoadZ.clear();
+        for (int i = 0; i < snap.roadSegments.size(); i++)
+            if (sceneVisible[roadFirst + i]) visibleRoadZ.push_back(snap.roadSegments[i].zStart);
+        if (visibleRoadZ != roadInstanceZ) {
+            roadInstanceMatrices.clear();
+            for (float z : visibleRoadZ)
+                roadInstanceMatrices.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, z)));
+            glBindBuffer(GL_ARRAY_BUFFER, roadInstanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, roadInstanceMatrices.size() * sizeof(glm::mat4), roadInstanceMatrices.data(), GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            roadInstanceZ = visibleRoadZ;
         }
-        else {
-            if (b.type == 0) pos.x += 2.5f;
-            else if (b.type == 1) pos.x += 3.0f;
-            else if (b.type == 2) pos.x += 3.8f;
-            else if (b.type == 3) pos.x += 5.0f;
+        int segmentCount = (int)roadInstanceMatrices.size();
+        renderQueue.AddInstanced(&instancedShader, &footpathMaterial, footpathVAO, 12, segmentCount);
+        renderQueue.AddInstanced(&instancedShader, &curbMaterial, curbVAO, 12, segmentCount);
+        renderQueue.AddInstanced(&instancedShader, &roadMaterial, roadVAO, 6, segmentCount);
+    }
+
+    // Obstacles and buildings, one instanced draw per mesh of each LOD level
+    for (auto& batch : obstacleBatches)
+        for (auto& level : batch.levels) level.matrices.clear();
+    for (auto& batch : buildingBatches)
+        for (auto& level : batch.levels) level.slots.clear();
+    {
+        ProfileScope scope(&profiler, PROFILE_OBSTACLES);
+        for (int i = 0; i < snap.obstacles.size(); i++)
+            if (sceneVisible[obstacleFirst + i]) addInstance(obstacleBatches[snap.obstacles.type[i]], obstacleMatrices[i]);
+        for (auto& batch : obstacleBatches) queueInstanceBatch(batch, instancedShader);
+    }
+    {
+        ProfileScope scope(&profiler, PROFILE_BUILDINGS);
+        for (int i = 0; i < bakedBuildings.size(); i++) {
+            const BakedBuilding& b = bakedBuildings[i];
+            if (sceneVisible[buildingFirst + i]) addStaticInstance(buildingBatches[b.type], b, buildingInstances.Slot((int)i));
         }
+        for (auto& batch : buildingBatches) queueInstanceBatch(batch, instancedShader);
+    }
+
+    {
+        GpuScope scope(&profiler, &gpuTimer, PROFILE_DRAW);
+        renderStats.stateChanges += renderQueue.Submit(renderStats, glState);
+        glState.Collect(renderStats);
+    }
+    shader.use();
+}
+
+glm::mat4 obstacleModelMatrix(const Obstacle& obs) {
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, obs.pos);
+
+    if (obs.type == 0) { // StopSign
+        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(1.0f));
+    }
+    else if (obs.type == 1) { // Cone
+        model = glm::scale(model, glm::vec3(0.6f));
+    }
+    else if (obs.type == 2) { // Barrel
+        model = glm::scale(model, glm::vec3(2.0f));
+    }
+    return model;
+}
+
+glm::mat4 buildingModelMatrix(const Building& b) {
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::vec3 pos = b.pos;
+
+    if (b.leftSide) {
+        if (b.type == 0) pos.x -= 2.5f;
+        else if (b.type == 1) pos.x -= 3.0f;
+        else if (b.type == 2) pos.x -= 3.8f;
+        else if (b.type == 3) pos.x -= 5.0f;
+    }
+    else {
+        if (b.type == 0) pos.x += 2.5f;
+        else if (b.type == 1) pos.x += 3.0f;
+        else if (b.type == 2) pos.x += 3.8f;
+        else if (b.type == 3) pos.x += 5.0f;
+    }
 
-        if (b.type == 2) pos.y += 3.1f;
+    if (b.type == 2) pos.y += 3.1f;
 
-        model = glm::translate(model, pos);
+    model = glm::translate(model, pos);
 
-        float baseAngle = 0.0f;
-        if (b.type == 0) baseAngle = -90.0f;
-        else if (b.type == 1) baseAngle = 90.0f;
-        else if (b.type == 2) baseAngle = 90.0f;
-        else if (b.type == 3) baseAngle = 90.0f;
+    float baseAngle = 0.0f;
+    if (b.type == 0) baseAngle = -90.0f;
+    else if (b.type == 1) baseAngle = 90.0f;
+    else if (b.type == 2) baseAngle = 90.0f;
+    else if (b.type == 3) baseAngle = 90.0f;
 
-        float finalAngle = b.leftSide ? baseAngle : -baseAngle;
-        model = glm::rotate(model, glm::radians(finalAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+    float finalAngle = b.leftSide ? baseAngle : -baseAngle;
+    model = glm::rotate(model, glm::radians(finalAngle), glm::vec3(0.0f, 1.0f, 0.0f));
 
-        if (b.type == 0) model = glm::scale(model, glm::vec3(1.00f));
-        else if (b.type == 1) model = glm::scale(model, glm::vec3(1.0f));
-        else if (b.type == 2) model = glm::scale(model, glm::vec3(0.8f));
-        else if (b.type == 3) model = glm::scale(model, glm::vec3(1.0f));
+    if (b.type == 0) model = glm::scale(model, glm::vec3(1.00f));
+    else if (b.type == 1) model = glm::scale(model, glm::vec3(1.0f));
+    else if (b.type == 2) model = glm::scale(model, glm::vec3(0.8f));
+    else if (b.type == 3) model = glm::scale(model, glm::vec3(1.0f));
+    return model;
+}
+
+// Table entries are the per-object matrices at the origin: translation is
+// applied first there, so moving an entity only adds to the last column
+void setupTransformTables() {
+    obstacleTransforms.entries.clear();
+    for (int type = 0; type < 3; type++)
+        obstacleTransforms.entries.push_back(obstacleModelMatrix({ glm::vec3(0.0f), type, 0 }));
+    buildingTransforms.entries.clear();
+    for (int type = 0; type < 4; type++)
+        for (int left = 0; left < 2; left++)
+            buildingTransforms.entries.push_back(buildingModelMatrix({ glm::vec3(0.0f), type, left == 1 }));
+}
 
-        shader.setMat4("model", model);
-        buildingModels[b.type]->Draw(shader);
+// Source a per-instance mat4 (locations 3-6, as in the instancing chapter)
+// from the buffer bound to GL_ARRAY_BUFFER. Model meshes use those
+// locations for tangents and bones, so they get it on instancedMeshVao().
+void attachInstanceMatrices(unsigned int VAO) {
+    glBindVertexArray(VAO);
+    for (int i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+        glVertexAttribDivisor(3 + i, 1);
     }
+    glBindVertexArray(0);
+}
 
+// Source a per-instance StaticInstances slot (location 3, for
+// shader_static_instanced.vs) from the buffer bound to GL_ARRAY_BUFFER
+void attachInstanceSlots(unsigned int VAO) {
+    glBindVertexArray(VAO);
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 1, GL_INT, sizeof(int), (void*)0);
+    glVertexAttribDivisor(3, 1);
     glBindVertexArray(0);
 }
 
-// Text rendering function
-void RenderText(Shader& shader, std::string text, float x, float y, float scale, glm::vec3 color) {
-    shader.use();
-    shader.setVec3("textColor", color);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(textVAO);
+// A second VAO over the mesh's vertex and index buffers with only position,
+// normal and texture coordinates, for the instance attributes to go on;
+// Mesh::VAO keeps the stock layout Mesh::Draw expects
+unsigned int instancedMeshVao(const Mesh& mesh) {
+    GLint vbo = 0, ebo = 0;
+    glBindVertexArray(mesh.VAO);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &vbo);
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &ebo);
+
+    unsigned int vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return vao;
+}
 
-    for (auto c = text.begin(); c != text.end(); c++) {
-        Character ch = Characters[*c];
+void setupInstanceBatch(InstanceBatch& batch, LoadedModel* model, StaticInstances* instances) {
+    batch.model = model;
+    batch.instances = instances;
+    batch.lodCount = model->LodCount();
+    batch.center = (model->boundsMin + model->boundsMax) * 0.5f;
+    batch.radius = glm::length(model->boundsMax - model->boundsMin) * 0.5f;
+    batch.levels.resize(batch.lodCount);
+    for (int l = 0; l < batch.lodCount; l++) {
+        InstanceBatch::Level& level = batch.levels[l];
+        glGenBuffers(1, &level.instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, level.instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_STREAM_DRAW);
+        for (auto& mesh : model->Lod(l)) {
+            unsigned int vao = instancedMeshVao(mesh);
+            glBindBuffer(GL_ARRAY_BUFFER, level.instanceVBO);
+            if (instances) attachInstanceSlots(vao);
+            else attachInstanceMatrices(vao);
+            level.parts.push_back({ vao, (int)mesh.indices.size(), Material::ForMesh(mesh) });
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-        float xpos = x + ch.Bearing.x * scale;
-        float ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
+// Bakes the model's impostor at the distance it first gets used, so the fog
+// in the captures matches the scene there
+Impostor bakeImpostor(LoadedModel& model, Shader& shader) {
+    float radius = glm::length(model.boundsMax - model.boundsMin) * 0.5f;  // As setupInstanceBatch() works it out
+    float distance = LodSettings::DistanceForSize(radius, lodSettings.impostorBelow, glm::radians(CAMERA_FOV));
+    Impostor impostor;
+    impostor.Bake(model, shader, distance);
+    return impostor;
+}
 
-        float w = ch.Size.x * scale;
-        float h = ch.Size.y * scale;
+// Adds a level per impostor view after the batch's mesh levels
+void setupImpostor(InstanceBatch& batch, const Impostor& impostor) {
+    for (int v = 0; v < Impostor::VIEWS; v++) {
+        InstanceBatch::Level level;
+        level.impostor = true;
+        glGenBuffers(1, &level.instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, level.instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_STREAM_DRAW);
+        if (batch.instances) attachInstanceSlots(impostor.VAOs[v]);
+        else attachInstanceMatrices(impostor.VAOs[v]);
+        level.parts.push_back({ impostor.VAOs[v], Impostor::INDEX_COUNT, Material::Diffuse(impostor.Textures[v]) });
+        batch.levels.push_back(level);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    batch.hasImpostor = true;
+}
 
-        float vertices[6][4] = {
-            { xpos,     ypos + h,   0.0f, 0.0f },
-            { xpos,     ypos,       0.0f, 1.0f },
-            { xpos + w, ypos,       1.0f, 1.0f },
+// LOD level the on-screen size of a world-space bounding sphere calls for;
+// batch.lodCount means the impostor
+int selectLod(const InstanceBatch& batch, const glm::vec3& center, float radius) {
+    float distance = glm::max(glm::length(center - camera.Position), 0.001f);
+    float size = LodSettings::ProjectedSize(radius, distance, glm::radians(CAMERA_FOV));
+    return lodSettings.Select(size, batch.lodCount, batch.hasImpostor);
+}
 
-            { xpos,     ypos + h,   0.0f, 0.0f },
-            { xpos + w, ypos,       1.0f, 1.0f },
-            { xpos + w, ypos + h,   1.0f, 0.0f }
-        };
+// Files one instance under the LOD level it needs
+void addInstance(InstanceBatch& batch, const glm::mat4& model) {
+    glm::vec3 center = glm::vec3(model * glm::vec4(batch.center, 1.0f));
+    float scale = glm::max(glm::length(glm::vec3(model[0])),
+        glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
 
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        x += (ch.Advance >> 6) * scale;
+    int level = selectLod(batch, center, batch.radius * scale);
+    if (level == batch.lodCount)
+        level += Impostor::ViewFor(glm::inverse(glm::mat3(model)) * (center - camera.Position));
+    batch.levels[level].matrices.push_back(model);
+}
+
+void addStaticInstance(InstanceBatch& batch, const BakedBuilding& building, int slot) {
+    int level = selectLod(batch, building.center, building.radius);
+    if (level == batch.lodCount)
+        level += Impostor::ViewFor(building.toModel * (building.center - camera.Position));
+    batch.levels[level].slots.push_back(slot);
+}
+
+// Brings bakedBuildings and buildingInstances in line with the buildings:
+// buildings the World dropped are retired from the front, and new ones are
+// baked and appended. This is the only building matrix maths there is.
+void syncBuildings(const BuildingList& buildings) {
+    while (!bakedBuildings.empty() && bakedFirstId < buildings.firstId) {
+        bakedBuildings.pop_front();
+        buildingInstances.Retire(1);
+        bakedFirstId++;
+    }
+    if (bakedBuildings.empty()) bakedFirstId = buildings.firstId;
+
+    int first = bakedBuildings.size();
+    int count = buildings.size() - first;
+    if (count == 0) return;
+    buildingVariants.resize(count);
+    buildingX.resize(count);
+    buildingZ.resize(count);
+    for (int i = 0; i < count; i++) {
+        buildingVariants[i] = buildings.type[first + i] * 2 + buildings.leftSide[first + i];
+        buildingX[i] = buildings.x[first + i];
+        buildingZ[i] = buildings.z[first + i];
+    }
+    buildingMatrices.resize(count);
+    buildingTransforms.Place(buildingVariants.data(), buildingX.data(), buildingZ.data(), count, buildingMatrices.data());
+    buildingInstances.Append(buildingMatrices.data(), count);
+
+    for (int i = 0; i < count; i++) {
+        const glm::mat4& m = buildingMatrices[i];
+        const InstanceBatch& batch = buildingBatches[buildings.type[first + i]];
+        BakedBuilding b;
+        b.type = buildings.type[first + i];
+        b.center = glm::vec3(m * glm::vec4(batch.center, 1.0f));
+        float scale = glm::max(glm::length(glm::vec3(m[0])),
+            glm::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+        b.radius = batch.radius * scale;
+        AabbList::Transform(m, batch.model->boundsMin, batch.model->boundsMax, b.boundsMin, b.boundsMax);
+        b.toModel = glm::inverse(glm::mat3(m));
+        bakedBuildings.push_back(b);
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-// Helper function to calculate text width
-float GetTextWidth(std::string text, float scale) {
-    float width = 0.0f;
-    for (auto c = text.begin(); c != text.end(); c++) {
-        Character ch = Characters[*c];
-        width += (ch.Advance >> 6) * scale;
+void queueInstanceBatch(InstanceBatch& batch, Shader& instancedShader) {
+    for (auto& level : batch.levels) {
+        int count = (int)(batch.instances ? level.slots.size() : level.matrices.size());
+        if (count == 0) continue;
+
+        // Orphan and refill the level's instance buffer for this frame
+        glBindBuffer(GL_ARRAY_BUFFER, level.instanceVBO);
+        if (batch.instances)
+            glBufferData(GL_ARRAY_BUFFER, count * sizeof(int), level.slots.data(), GL_STREAM_DRAW);
+        else
+            glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), level.matrices.data(), GL_STREAM_DRAW);
+
+        Shader* program = levelShader(batch, level, instancedShader);
+        for (auto& part : level.parts)
+            renderQueue.AddInstanced(program, &part.material, part.VAO, part.indexCount, count);
     }
-    return width;
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+Shader* levelShader(const InstanceBatch& batch, const InstanceBatch::Level& level, Shader& instancedShader) {
+    return level.impostor ? impostorShader : batch.instances ? buildingShader : &instancedShader;
 }
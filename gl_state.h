@@ -0,0 +1,205 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader_m.h>
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "profiler.h"
+
+// Camera constants written once per frame into one uniform buffer that every
+// scene program declaring the block reads, instead of as uniforms per
+// program:
+//     layout (std140) uniform Frame { mat4 projection; mat4 view; vec4 cameraPos; } frame;
+// Programs without the block keep plain uniforms, written through GlState.
+class FrameUniforms {
+public:
+    static const unsigned int BINDING = 0;
+
+    struct Block {  // std140 layout of Frame
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec4 cameraPos;
+    };
+
+    void Init()
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, buffer);
+    }
+
+    // Points the program's Frame block at the buffer; false if it has none
+    bool Attach(const Shader& shader)
+    {
+        unsigned int index = glGetUniformBlockIndex(shader.ID, "Frame");
+        if (index == GL_INVALID_INDEX) return false;
+        glUniformBlockBinding(shader.ID, index, BINDING);
+        return true;
+    }
+
+    void Update(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& cameraPos)
+    {
+        Block block = { projection, view, glm::vec4(cameraPos, 1.0f) };
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+    unsigned int buffer = 0;
+};
+
+// Redundant-state filter for the scene passes: a program, VAO or texture
+// that is already bound, or a uniform that already holds the value, is not
+// sent again. Uniform locations are looked up once per program and name
+// instead of by name on every write.
+//
+// Bindings are forgotten by Reset(), which must be called before use
+// whenever other code may have touched them (text, setup, timers). Uniform
+// values are remembered for as long as the programs live, so once a program
+// is in use here its uniforms must only be written through here.
+class GlState {
+public:
+    static const int MAX_UNITS = 8;
+
+    // Uniforms the scene programs share, -1 where a program doesn't use one
+    struct Common {
+        int model = -1, view = -1, projection = -1, cameraPos = -1;
+    };
+
+    int binds = 0;     // Programs, VAOs and textures bound
+    int uniforms = 0;  // glUniform* calls made
+    int skipped = 0;   // Binds and uniform writes left out as redundant
+
+    // Resolves the program's common locations; call once after linking
+    const Common& Register(const Shader& shader) { return Entry(shader.ID).common; }
+    const Common& Uniforms(const Shader& shader) { return Entry(shader.ID).common; }
+
+    int Location(const Shader& shader, const std::string& name)
+    {
+        Program& p = Entry(shader.ID);
+        for (const auto& n : p.named)
+            if (n.first == name) return n.second;
+        int location = glGetUniformLocation(shader.ID, name.c_str());
+        p.named.push_back({ name, location });
+        return location;
+    }
+
+    void Reset()
+    {
+        program = vao = 0;
+        activeUnit = -1;
+        for (int i = 0; i < MAX_UNITS; i++) textures[i] = 0;
+    }
+
+    void UseProgram(const Shader& shader)
+    {
+        if (shader.ID == program) { skipped++; return; }
+        glUseProgram(shader.ID);
+        program = shader.ID;
+        binds++;
+    }
+
+    void BindVertexArray(unsigned int id)
+    {
+        if (id == vao) { skipped++; return; }
+        glBindVertexArray(id);
+        vao = id;
+        binds++;
+    }
+
+    // GL_TEXTURE_2D on texture unit `unit`
+    void BindTexture(int unit, unsigned int texture)
+    {
+        if (unit >= MAX_UNITS) return;
+        if (textures[unit] == texture) { skipped++; return; }
+        if (activeUnit != unit) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            activeUnit = unit;
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+        textures[unit] = texture;
+        binds++;
+    }
+
+    // Uniform writes make the shader current when they go through
+    void SetInt(const Shader& shader, int location, int value)
+    {
+        if (Changed(shader, location, &value, sizeof(value))) glUniform1i(location, value);
+    }
+
+    void SetVec3(const Shader& shader, int location, const glm::vec3& value)
+    {
+        if (Changed(shader, location, &value[0], sizeof(value))) glUniform3fv(location, 1, &value[0]);
+    }
+
+    void SetMat4(const Shader& shader, int location, const glm::mat4& value)
+    {
+        if (Changed(shader, location, &value[0][0], sizeof(value))) glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+    }
+
+    // Adds this frame's counts to stats and starts counting afresh
+    void Collect(RenderStats& stats)
+    {
+        stats.uniformWrites += uniforms;
+        stats.redundantSkipped += skipped;
+        binds = uniforms = skipped = 0;
+    }
+
+private:
+    struct Value {
+        size_t size = 0;  // 0 until first written
+        unsigned char bytes[sizeof(glm::mat4)];
+    };
+    struct Program {
+        bool resolved = false;
+        Common common;
+        std::vector<std::pair<std::string, int>> named;
+        std::vector<Value> values;  // By location
+    };
+
+    std::vector<Program> programs;  // By program name
+    unsigned int program = 0, vao = 0;
+    unsigned int textures[MAX_UNITS] = {};
+    int activeUnit = -1;
+
+    Program& Entry(unsigned int id)
+    {
+        if (id >= programs.size()) programs.resize(id + 1);
+        Program& p = programs[id];
+        if (!p.resolved) {
+            p.common.model = glGetUniformLocation(id, "model");
+            p.common.view = glGetUniformLocation(id, "view");
+            p.common.projection = glGetUniformLocation(id, "projection");
+            p.common.cameraPos = glGetUniformLocation(id, "cameraPos");
+            p.resolved = true;
+        }
+        return p;
+    }
+
+    // Records the value and binds the program when it differs from what the
+    // location last held
+    bool Changed(const Shader& shader, int location, const void* data, size_t size)
+    {
+        if (location < 0) return false;
+        std::vector<Value>& values = Entry(shader.ID).values;
+        if ((size_t)location >= values.size()) values.resize(location + 1);
+        Value& v = values[location];
+        if (v.size == size && std::memcmp(v.bytes, data, size) == 0) { skipped++; return false; }
+        std::memcpy(v.bytes, data, size);
+        v.size = size;
+        if (shader.ID != program) UseProgram(shader);
+        uniforms++;
+        return true;
+    }
+};
+
+#endif
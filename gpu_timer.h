@@ -0,0 +1,72 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include "profiler.h"
+
+// GL_TIME_ELAPSED queries per profile section. Each frame uses its own set of
+// query objects and results are collected LATENCY frames later, so reading
+// them never stalls the pipeline. Elapsed queries can't nest: only time leaf
+// sections with it.
+class GpuTimer {
+public:
+    static const int LATENCY = 3;
+
+    void Init()
+    {
+        glGenQueries(LATENCY * PROFILE_SECTION_COUNT, &queries[0][0]);
+    }
+
+    // Collects the results of the oldest frame and makes its queries current
+    void BeginFrame(Profiler& profiler)
+    {
+        frame = (frame + 1) % LATENCY;
+        for (int s = 0; s < PROFILE_SECTION_COUNT; s++) {
+            if (!pending[frame][s]) continue;
+            pending[frame][s] = false;
+
+            GLint available = 0;
+            glGetQueryObjectiv(queries[frame][s], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) continue;  // Drop the sample rather than wait
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(queries[frame][s], GL_QUERY_RESULT, &ns);
+            profiler.AddSample((ProfileSection)s, Profiler::GPU, startUs[frame][s], ns / 1000.0);
+        }
+    }
+
+    void Begin(ProfileSection section, double cpuStartUs)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, queries[frame][section]);
+        pending[frame][section] = true;
+        startUs[frame][section] = cpuStartUs;
+    }
+
+    void End() { glEndQuery(GL_TIME_ELAPSED); }
+
+private:
+    unsigned int queries[LATENCY][PROFILE_SECTION_COUNT];
+    bool pending[LATENCY][PROFILE_SECTION_COUNT] = {};
+    double startUs[LATENCY][PROFILE_SECTION_COUNT] = {};
+    int frame = 0;
+};
+
+// Times the enclosing block on the CPU and, when a GpuTimer is given, the GPU
+class GpuScope {
+public:
+    GpuScope(Profiler* profiler, GpuTimer* gpu, ProfileSection section)
+        : cpu(profiler, section), gpu(gpu)
+    {
+        if (gpu) gpu->Begin(section, profiler ? profiler->NowUs() : 0.0);
+    }
+    ~GpuScope()
+    {
+        if (gpu) gpu->End();
+    }
+
+private:
+    ProfileScope cpu;
+    GpuTimer* gpu;
+};
+
+#endif
@@ -0,0 +1,17 @@
+#version 330 core
+in vec2 TexCoords;
+in vec3 FragPos;
+in float FragDepth;
+
+out vec4 FragColor;
+
+// Capture of the model with shading and fog already applied
+uniform sampler2D texture_diffuse1;
+
+void main()
+{
+    vec4 color = texture(texture_diffuse1, TexCoords);
+    if (color.a < 0.5)
+        discard;
+    FragColor = vec4(color.rgb, 1.0);
+}
\ No newline at end of file
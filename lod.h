@@ -0,0 +1,188 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <learnopengl/shader_m.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "asset_loader.h"
+
+// Screen-size LOD selection. Sizes are the projected diameter of a model's
+// bounding sphere as a fraction of the screen height.
+struct LodSettings {
+    enum Quality { LOW, MEDIUM, HIGH };
+
+    float minScreenSize[2];  // Smallest size at which LOD 0, then LOD 1, is still used
+    float impostorBelow;     // Models with impostors switch to them below this; 0 disables
+
+    static LodSettings ForQuality(Quality quality)
+    {
+        if (quality == HIGH) return { { 0.25f, 0.10f }, 0.0f };
+        if (quality == LOW) return { { 0.50f, 0.25f }, 0.10f };
+        return { { 0.35f, 0.15f }, 0.05f };
+    }
+
+    static bool ParseQuality(const char* name, Quality& quality)
+    {
+        if (strcmp(name, "low") == 0) quality = LOW;
+        else if (strcmp(name, "medium") == 0) quality = MEDIUM;
+        else if (strcmp(name, "high") == 0) quality = HIGH;
+        else return false;
+        return true;
+    }
+
+    static float ProjectedSize(float radius, float distance, float fovY)
+    {
+        return radius / (distance * std::tan(fovY * 0.5f));
+    }
+
+    // Distance at which a sphere of this radius shrinks to the given size
+    static float DistanceForSize(float radius, float size, float fovY)
+    {
+        return radius / (size * std::tan(fovY * 0.5f));
+    }
+
+    // LOD level for a model with lodCount levels; lodCount means its impostor
+    int Select(float size, int lodCount, bool hasImpostor) const
+    {
+        if (hasImpostor && impostorBelow > 0.0f && size < impostorBelow) return lodCount;
+        int level = 0;
+        while (level < lodCount - 1 && level < 2 && size < minScreenSize[level]) level++;
+        return level;
+    }
+};
+
+// Billboard stand-in for a distant model: the model rendered with the scene
+// shader into an RGBA texture from four horizontal directions, so its
+// shading and the fog at the capture distance are baked in. Each view gets a
+// quad through the model's centre, facing the camera it was captured from.
+class Impostor {
+public:
+    static const int VIEWS = 4;
+    static const int RESOLUTION = 256;
+
+    unsigned int Textures[VIEWS] = {};
+    unsigned int VAOs[VIEWS] = {};
+    static const int INDEX_COUNT = 6;
+
+    // Direction the capture camera looks along, in model space
+    static glm::vec3 ViewDirection(int view)
+    {
+        const glm::vec3 directions[VIEWS] = {
+            glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+            glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f)
+        };
+        return directions[view];
+    }
+
+    // View whose capture direction is closest to dir (model space)
+    static int ViewFor(const glm::vec3& dir)
+    {
+        int best = 0;
+        float bestDot = -1e30f;
+        for (int v = 0; v < VIEWS; v++) {
+            float d = glm::dot(dir, ViewDirection(v));
+            if (d > bestDot) { bestDot = d; best = v; }
+        }
+        return best;
+    }
+
+    // Renders the captures; needs the GL context and leaves the bound
+    // framebuffer, viewport and clear colour as they were
+    void Bake(LoadedModel& model, Shader& shader, float captureDistance)
+    {
+        GLint previousFbo = 0, viewport[4];
+        GLfloat clearColor[4];
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+        unsigned int fbo, depth;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, RESOLUTION, RESOLUTION);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        glViewport(0, 0, RESOLUTION, RESOLUTION);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);  // Alpha 0 wherever the model isn't
+
+        glm::vec3 center = (model.boundsMin + model.boundsMax) * 0.5f;
+        glm::vec3 extent = (model.boundsMax - model.boundsMin) * 0.5f;
+        glm::vec3 up(0.0f, 1.0f, 0.0f);
+
+        for (int v = 0; v < VIEWS; v++) {
+            glm::vec3 dir = ViewDirection(v);
+            glm::vec3 right = glm::cross(dir, up);
+            float halfWidth = std::fabs(right.x) * extent.x + std::fabs(right.z) * extent.z;
+            float halfDepth = std::fabs(dir.x) * extent.x + std::fabs(dir.z) * extent.z;
+            float distance = std::max(captureDistance, halfDepth + 1.0f);
+            glm::vec3 eye = center - dir * distance;
+
+            glGenTextures(1, &Textures[v]);
+            glBindTexture(GL_TEXTURE_2D, Textures[v]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, RESOLUTION, RESOLUTION, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, Textures[v], 0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            shader.use();
+            shader.setMat4("projection", glm::ortho(-halfWidth, halfWidth, -extent.y, extent.y,
+                distance - halfDepth - 0.1f, distance + halfDepth + 0.1f));
+            shader.setMat4("view", glm::lookAt(eye, center, up));
+            shader.setVec3("cameraPos", eye);
+            shader.setMat4("model", glm::mat4(1.0f));
+            model.Draw(shader);
+
+            glBindTexture(GL_TEXTURE_2D, Textures[v]);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+            // The camera's right is +u in the capture, as seen from eye
+            glm::vec3 r = right * halfWidth, u = up * extent.y, n = -dir;
+            glm::vec3 corners[4] = { center - r - u, center + r - u, center + r + u, center - r + u };
+            float uvs[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+            float vertices[4 * 8];
+            for (int i = 0; i < 4; i++) {
+                float* p = &vertices[i * 8];
+                p[0] = corners[i].x; p[1] = corners[i].y; p[2] = corners[i].z;
+                p[3] = n.x; p[4] = n.y; p[5] = n.z;
+                p[6] = uvs[i][0]; p[7] = uvs[i][1];
+            }
+            unsigned int indices[INDEX_COUNT] = { 0, 1, 2, 2, 3, 0 };
+
+            unsigned int vbo, ebo;
+            glGenVertexArrays(1, &VAOs[v]);
+            glGenBuffers(1, &vbo);
+            glGenBuffers(1, &ebo);
+            glBindVertexArray(VAOs[v]);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+            glEnableVertexAttribArray(2);
+            glBindVertexArray(0);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+        glDeleteRenderbuffers(1, &depth);
+        glDeleteFramebuffers(1, &fbo);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    }
+};
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "asset_cache.h"
+
+// Import-time mesh optimisation, run by the asset loader workers before a
+// model is cached: meshes that share a material become one, duplicate
+// vertices are welded, and triangles/vertices are reordered for the GPU's
+// post-transform and fetch caches.
+class MeshOptimizer {
+public:
+    static void Optimize(AssetData& data)
+    {
+        MergeByMaterial(data.meshes);
+        for (MeshData& mesh : data.meshes) {
+            Weld(mesh);
+            OptimizeVertexCache(mesh);
+            ReorderVertices(mesh);
+        }
+        BuildLods(data);
+    }
+
+    // Appends LOD levels made with Simplify(), with cells of 1/64 then 1/24 of
+    // the model's bounding diagonal. A level that saves less than 15% of the
+    // previous level's triangles ends the chain.
+    static void BuildLods(AssetData& data)
+    {
+        const float CELL_FRACTIONS[] = { 1.0f / 64.0f, 1.0f / 24.0f };
+        data.lods.clear();
+        if (data.meshes.empty()) return;
+        glm::vec3 lo = data.meshes[0].boundsMin, hi = data.meshes[0].boundsMax;
+        for (const MeshData& mesh : data.meshes) {
+            lo = glm::min(lo, mesh.boundsMin);
+            hi = glm::max(hi, mesh.boundsMax);
+        }
+        float diagonal = glm::length(hi - lo);
+        if (diagonal <= 0.0f) return;
+
+        const std::vector<MeshData>* previous = &data.meshes;
+        for (float fraction : CELL_FRACTIONS) {
+            std::vector<MeshData> level;
+            size_t before = 0, after = 0;
+            for (const MeshData& mesh : *previous) {
+                level.push_back(Simplify(mesh, diagonal * fraction));
+                before += mesh.indices.size();
+                after += level.back().indices.size();
+            }
+            if (after > before * 0.85) break;
+            data.lods.push_back(std::move(level));
+            previous = &data.lods.back();
+        }
+    }
+
+    // Meshes with the same texture list are concatenated into the first one
+    static void MergeByMaterial(std::vector<MeshData>& meshes)
+    {
+        std::vector<MeshData> merged;
+        for (MeshData& mesh : meshes) {
+            MeshData* target = NULL;
+            for (MeshData& m : merged)
+                if (m.images == mesh.images) { target = &m; break; }
+            if (!target) {
+                merged.push_back(std::move(mesh));
+                continue;
+            }
+            unsigned int base = (unsigned int)target->vertices.size();
+            target->vertices.insert(target->vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+            for (unsigned int index : mesh.indices)
+                target->indices.push_back(base + index);
+            target->boundsMin = glm::min(target->boundsMin, mesh.boundsMin);
+            target->boundsMax = glm::max(target->boundsMax, mesh.boundsMax);
+        }
+        meshes = std::move(merged);
+    }
+
+    // Collapses bit-identical vertices (Assimp emits one per face corner)
+    static void Weld(MeshData& mesh)
+    {
+        size_t count = mesh.vertices.size();
+        size_t tableSize = 1;
+        while (tableSize < count * 2) tableSize *= 2;
+        std::vector<unsigned int> table(tableSize, EMPTY);  // Open addressing, welded vertex indices
+        std::vector<unsigned int> remap(count);
+        std::vector<Vertex> welded;
+        welded.reserve(count);
+
+        for (size_t i = 0; i < count; i++) {
+            const Vertex& v = mesh.vertices[i];
+            size_t slot = Hash(v) & (tableSize - 1);
+            while (table[slot] != EMPTY && memcmp(&welded[table[slot]], &v, sizeof(Vertex)) != 0)
+                slot = (slot + 1) & (tableSize - 1);
+            if (table[slot] == EMPTY) {
+                table[slot] = (unsigned int)welded.size();
+                welded.push_back(v);
+            }
+            remap[i] = table[slot];
+        }
+        for (unsigned int& index : mesh.indices) index = remap[index];
+        mesh.vertices = std::move(welded);
+    }
+
+    // Tom Forsyth's "Linear-Speed Vertex Cache Optimisation": greedily emits
+    // the triangle whose vertices score highest for being recently used and
+    // having few remaining triangles
+    static void OptimizeVertexCache(MeshData& mesh)
+    {
+        const int CACHE_SIZE = 32;
+        size_t vertexCount = mesh.vertices.size();
+        size_t triCount = mesh.indices.size() / 3;
+        if (triCount == 0) return;
+
+        // Triangles using each vertex, as offsets into one flat array
+        std::vector<unsigned int> useCount(vertexCount, 0), firstTri(vertexCount + 1, 0);
+        for (unsigned int index : mesh.indices) useCount[index]++;
+        for (size_t v = 0; v < vertexCount; v++) firstTri[v + 1] = firstTri[v] + useCount[v];
+        std::vector<unsigned int> vertexTris(mesh.indices.size());
+        std::vector<unsigned int> fill(firstTri.begin(), firstTri.end() - 1);
+        for (size_t t = 0; t < triCount; t++)
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = mesh.indices[t * 3 + k];
+                vertexTris[fill[v]++] = (unsigned int)t;
+            }
+
+        std::vector<unsigned int> activeTris(useCount);  // Triangles not yet emitted
+        std::vector<int> cachePos(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) vertexScore[v] = VertexScore(-1, activeTris[v], CACHE_SIZE);
+        std::vector<float> triScore(triCount);
+        std::vector<bool> emitted(triCount, false);
+        for (size_t t = 0; t < triCount; t++)
+            triScore[t] = vertexScore[mesh.indices[t * 3]] + vertexScore[mesh.indices[t * 3 + 1]] + vertexScore[mesh.indices[t * 3 + 2]];
+
+        std::vector<unsigned int> output;
+        output.reserve(mesh.indices.size());
+        std::vector<unsigned int> cache, newCache;
+        cache.reserve(CACHE_SIZE + 3);
+        newCache.reserve(CACHE_SIZE + 3);
+        size_t scan = 0;  // Fallback when the cache has nothing left: next unemitted triangle
+        int best = NextUnemitted(emitted, scan);
+
+        while (best >= 0) {
+            emitted[best] = true;
+            newCache.clear();
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = mesh.indices[best * 3 + k];
+                output.push_back(v);
+                newCache.push_back(v);
+                // Drop the emitted triangle from the vertex's active list
+                unsigned int* tris = &vertexTris[firstTri[v]];
+                for (unsigned int i = 0; i < activeTris[v]; i++)
+                    if (tris[i] == (unsigned int)best) { std::swap(tris[i], tris[activeTris[v] - 1]); break; }
+                activeTris[v]--;
+            }
+            for (unsigned int v : cache)
+                if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) newCache.push_back(v);
+            std::swap(cache, newCache);  // newCache now holds the previous cache
+
+            // Rescore vertices whose cache position changed, including evictions
+            for (size_t i = 0; i < cache.size(); i++) cachePos[cache[i]] = i < (size_t)CACHE_SIZE ? (int)i : -1;
+            best = -1;
+            float bestScore = -1.0f;
+            for (size_t i = 0; i < cache.size(); i++) {
+                unsigned int v = cache[i];
+                vertexScore[v] = VertexScore(cachePos[v], activeTris[v], CACHE_SIZE);
+            }
+            for (size_t i = 0; i < cache.size(); i++) {
+                unsigned int v = cache[i];
+                for (unsigned int j = 0; j < activeTris[v]; j++) {
+                    unsigned int t = vertexTris[firstTri[v] + j];
+                    triScore[t] = vertexScore[mesh.indices[t * 3]] + vertexScore[mesh.indices[t * 3 + 1]] + vertexScore[mesh.indices[t * 3 + 2]];
+                    if (triScore[t] > bestScore) { bestScore = triScore[t]; best = (int)t; }
+                }
+            }
+            if (cache.size() > (size_t)CACHE_SIZE) cache.resize(CACHE_SIZE);
+            if (best < 0) best = NextUnemitted(emitted, scan);
+        }
+        mesh.indices = std::move(output);
+    }
+
+    // Renumbers vertices in order of first use so fetches walk memory forwards
+    static void ReorderVertices(MeshData& mesh)
+    {
+        std::vector<unsigned int> remap(mesh.vertices.size(), EMPTY);
+        std::vector<Vertex> ordered;
+        ordered.reserve(mesh.vertices.size());
+        for (unsigned int& index : mesh.indices) {
+            if (remap[index] == EMPTY) {
+                remap[index] = (unsigned int)ordered.size();
+                ordered.push_back(mesh.vertices[index]);
+            }
+            index = remap[index];
+        }
+        mesh.vertices = std::move(ordered);  // Vertices no triangle uses are dropped
+    }
+
+    // Vertex clustering: snaps vertices to a grid of the given cell size, merges
+    // each cell into one vertex at the cell's average position (other
+    // attributes from the first vertex seen) and drops collapsed triangles.
+    // Cruder than edge collapse, but fast, and these levels are only ever
+    // seen from far away.
+    static MeshData Simplify(const MeshData& mesh, float cellSize)
+    {
+        MeshData out;
+        out.images = mesh.images;
+        out.boundsMin = mesh.boundsMin;
+        out.boundsMax = mesh.boundsMax;
+
+        std::unordered_map<uint64_t, unsigned int> cells;
+        std::vector<unsigned int> remap(mesh.vertices.size());
+        std::vector<glm::vec3> sums;
+        std::vector<int> counts;
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            const Vertex& v = mesh.vertices[i];
+            glm::ivec3 cell = glm::ivec3(glm::floor((v.Position - mesh.boundsMin) / cellSize));
+            uint64_t key = (uint64_t)(cell.x & 0x1FFFFF) | ((uint64_t)(cell.y & 0x1FFFFF) << 21) | ((uint64_t)(cell.z & 0x1FFFFF) << 42);
+            auto it = cells.find(key);
+            if (it == cells.end()) {
+                it = cells.emplace(key, (unsigned int)out.vertices.size()).first;
+                out.vertices.push_back(v);
+                sums.push_back(glm::vec3(0.0f));
+                counts.push_back(0);
+            }
+            remap[i] = it->second;
+            sums[it->second] += v.Position;
+            counts[it->second]++;
+        }
+        for (size_t i = 0; i < out.vertices.size(); i++)
+            out.vertices[i].Position = sums[i] / (float)counts[i];
+
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+            unsigned int a = remap[mesh.indices[t]], b = remap[mesh.indices[t + 1]], c = remap[mesh.indices[t + 2]];
+            if (a == b || b == c || a == c) continue;
+            out.indices.push_back(a);
+            out.indices.push_back(b);
+            out.indices.push_back(c);
+        }
+        OptimizeVertexCache(out);
+        ReorderVertices(out);
+        return out;
+    }
+
+    // Average cache misses per triangle for a FIFO cache of the given size
+    static float Acmr(const MeshData& mesh, int cacheSize = 16)
+    {
+        if (mesh.indices.empty()) return 0.0f;
+        std::vector<unsigned int> fifo;
+        int misses = 0;
+        for (unsigned int index : mesh.indices) {
+            if (std::find(fifo.begin(), fifo.end(), index) != fifo.end()) continue;
+            misses++;
+            fifo.push_back(index);
+            if ((int)fifo.size() > cacheSize) fifo.erase(fifo.begin());
+        }
+        return misses / (mesh.indices.size() / 3.0f);
+    }
+
+private:
+    static const unsigned int EMPTY = ~0u;
+
+    static uint64_t Hash(const Vertex& v)
+    {
+        const unsigned char* p = (const unsigned char*)&v;
+        uint64_t h = 1469598103934665603ull;
+        for (size_t i = 0; i < sizeof(Vertex); i++) {
+            h ^= p[i];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    static float VertexScore(int cachePos, unsigned int activeTris, int cacheSize)
+    {
+        if (activeTris == 0) return -1.0f;  // Nothing left to emit with it
+        float score = 0.0f;
+        if (cachePos >= 0) {
+            if (cachePos < 3) score = 0.75f;  // In the last triangle: fixed score
+            else score = std::pow(1.0f - (cachePos - 3) / (float)(cacheSize - 3), 1.5f);
+        }
+        return score + 2.0f * std::pow((float)activeTris, -0.5f);  // Favour finishing off lone vertices
+    }
+
+    static int NextUnemitted(const std::vector<bool>& emitted, size_t& scan)
+    {
+        while (scan < emitted.size() && emitted[scan]) scan++;
+        return scan < emitted.size() ? (int)scan : -1;
+    }
+};
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal microbenchmark runner in the manner of Google Benchmark: a case is
+// a function run for a number of iterations, repeated with more iterations
+// until it takes MinSeconds. Results print as a table and can be written as
+// Google Benchmark JSON, so its tools/compare.py can diff two runs.
+class MicroBench {
+public:
+    struct Result {
+        std::string name;
+        long long iterations;
+        double nsPerIteration;
+        double itemsPerSecond;  // 0 when the case has no item count
+    };
+
+    double MinSeconds = 0.2;
+    std::string Filter;  // Only cases whose name contains this run
+    std::vector<Result> Results;
+
+    bool Wants(const std::string& name) const
+    {
+        return Filter.empty() || name.find(Filter) != std::string::npos;
+    }
+
+    // fn(iterations) runs the case that many times; items is how many
+    // things (entities, characters, ticks) one iteration handles
+    template <typename Fn>
+    void Run(const std::string& name, Fn fn, long long items = 0)
+    {
+        if (!Wants(name)) return;
+        long long iterations = 1;
+        double seconds = 0.0;
+        for (;;) {
+            auto start = std::chrono::steady_clock::now();
+            fn(iterations);
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (seconds >= MinSeconds || iterations >= 1000000000LL) break;
+            // Aim a little past MinSeconds, growing at most 10x per try
+            double scale = seconds > 0.0 ? MinSeconds * 1.4 / seconds : 10.0;
+            iterations = std::max(iterations + 1, (long long)(iterations * std::min(scale, 10.0)));
+        }
+        Record(name, iterations, seconds * 1e9, items);
+    }
+
+    // A case timed by the caller, e.g. a fixed-length session
+    void Record(const std::string& name, long long iterations, double totalNs, long long items = 0)
+    {
+        if (!Wants(name) || iterations <= 0) return;
+        double ns = totalNs / iterations;
+        Results.push_back({ name, iterations, ns, items > 0 && ns > 0.0 ? items * 1e9 / ns : 0.0 });
+        const Result& r = Results.back();
+        if (r.itemsPerSecond > 0.0)
+            printf("%-48s %14.1f ns %12lld %12.4g items/s\n", r.name.c_str(), r.nsPerIteration, r.iterations, r.itemsPerSecond);
+        else
+            printf("%-48s %14.1f ns %12lld\n", r.name.c_str(), r.nsPerIteration, r.iterations);
+        fflush(stdout);
+    }
+
+    void PrintHeader() const
+    {
+        printf("%-48s %17s %12s\n", "Benchmark", "Time", "Iterations");
+        printf("%s\n", std::string(79, '-').c_str());
+    }
+
+    // Wall time is reported as both real_time and cpu_time
+    bool WriteJson(const std::string& path, const std::string& executable) const
+    {
+        FILE* f = fopen(path.c_str(), "w");
+        if (!f) return false;
+        char date[32];
+        time_t now = time(0);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+        fprintf(f, "{\n  \"context\": {\n");
+        fprintf(f, "    \"date\": \"%s\",\n", date);
+        fprintf(f, "    \"executable\": \"%s\",\n", executable.c_str());
+        fprintf(f, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+#ifdef NDEBUG
+        fprintf(f, "    \"library_build_type\": \"release\"\n");
+#else
+        fprintf(f, "    \"library_build_type\": \"debug\"\n");
+#endif
+        fprintf(f, "  },\n  \"benchmarks\": [");
+        for (size_t i = 0; i < Results.size(); i++) {
+            const Result& r = Results[i];
+            fprintf(f, "%s\n    {\n", i ? "," : "");
+            fprintf(f, "      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n      \"run_type\": \"iteration\",\n",
+                r.name.c_str(), r.name.c_str());
+            fprintf(f, "      \"iterations\": %lld,\n", r.iterations);
+            fprintf(f, "      \"real_time\": %.3f,\n      \"cpu_time\": %.3f,\n", r.nsPerIteration, r.nsPerIteration);
+            if (r.itemsPerSecond > 0.0)
+                fprintf(f, "      \"items_per_second\": %.1f,\n", r.itemsPerSecond);
+            fprintf(f, "      \"time_unit\": \"ns\"\n    }");
+        }
+        fprintf(f, "\n  ]\n}\n");
+        fclose(f);
+        return true;
+    }
+};
+
+// Keeps the compiler from dropping work whose result is otherwise unused
+template <typename T>
+inline void KeepValue(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r"(&value) : "memory");
+#else
+    static volatile char sink;
+    sink = *(const volatile char*)&value;
+#endif
+}
+
+#endif
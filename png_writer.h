@@ -0,0 +1,104 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Minimal PNG encoder for frame snapshots: 8-bit RGB, deflate "stored" blocks
+// (no compression). Files are larger than a real encoder's but byte-identical
+// for identical frames, which is all image-diff regression checks need.
+class PngWriter {
+public:
+    // rgb is width * height * 3 bytes, top row first
+    static bool Write(const std::string& path, int width, int height, const unsigned char* rgb)
+    {
+        // Raw scanlines, each prefixed with filter type 0 (none)
+        std::vector<unsigned char> raw;
+        raw.reserve((size_t)(width * 3 + 1) * height);
+        for (int y = 0; y < height; y++) {
+            raw.push_back(0);
+            raw.insert(raw.end(), rgb + (size_t)y * width * 3, rgb + (size_t)(y + 1) * width * 3);
+        }
+
+        // zlib stream: header, stored blocks of up to 65535 bytes, Adler-32
+        std::vector<unsigned char> z = { 0x78, 0x01 };
+        size_t pos = 0;
+        do {
+            size_t len = std::min<size_t>(raw.size() - pos, 65535);
+            z.push_back(pos + len == raw.size() ? 1 : 0);  // BFINAL on the last block
+            z.push_back(len & 0xFF);
+            z.push_back((len >> 8) & 0xFF);
+            z.push_back(~len & 0xFF);
+            z.push_back((~len >> 8) & 0xFF);
+            z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + len);
+            pos += len;
+        } while (pos < raw.size());
+        PutU32(z, Adler32(raw));
+
+        std::vector<unsigned char> ihdr;
+        PutU32(ihdr, (uint32_t)width);
+        PutU32(ihdr, (uint32_t)height);
+        ihdr.insert(ihdr.end(), { 8, 2, 0, 0, 0 });  // 8-bit, RGB, deflate, no filter, no interlace
+
+        std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        PutChunk(png, "IHDR", ihdr);
+        PutChunk(png, "IDAT", z);
+        PutChunk(png, "IEND", std::vector<unsigned char>());
+
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+        bool ok = fwrite(png.data(), 1, png.size(), f) == png.size();
+        fclose(f);
+        return ok;
+    }
+
+private:
+    static void PutU32(std::vector<unsigned char>& out, uint32_t v)
+    {
+        out.push_back((v >> 24) & 0xFF);
+        out.push_back((v >> 16) & 0xFF);
+        out.push_back((v >> 8) & 0xFF);
+        out.push_back(v & 0xFF);
+    }
+
+    static void PutChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+    {
+        PutU32(out, (uint32_t)data.size());
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        PutU32(out, Crc32(&out[start], out.size() - start));  // Over type and data
+    }
+
+    static uint32_t Crc32(const unsigned char* data, size_t len)
+    {
+        static uint32_t table[256];
+        static bool built = false;
+        if (!built) {
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+            built = true;
+        }
+        uint32_t c = 0xFFFFFFFFu;
+        for (size_t i = 0; i < len; i++) c = table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+        return c ^ 0xFFFFFFFFu;
+    }
+
+    static uint32_t Adler32(const std::vector<unsigned char>& data)
+    {
+        uint32_t a = 1, b = 0;
+        for (unsigned char byte : data) {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        return (b << 16) | a;
+    }
+};
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Lightweight frame profiler. CPU sections are timed with ProfileScope; GPU
+// times (from GpuTimer in game.cpp) are fed in with AddSample(). Nothing here
+// needs GL, so the World can be profiled headless too.
+
+enum ProfileSection {
+    PROFILE_FRAME,
+    PROFILE_UPDATE,
+    PROFILE_ROAD_GEN,
+    PROFILE_SPAWN_OBSTACLES,
+    PROFILE_SPAWN_BUILDINGS,
+    PROFILE_COLLISION,
+    PROFILE_RENDER,
+    PROFILE_CULL,
+    PROFILE_CAR,
+    PROFILE_GRASS,
+    PROFILE_ROAD,
+    PROFILE_OBSTACLES,
+    PROFILE_BUILDINGS,
+    PROFILE_DRAW,
+    PROFILE_TEXT,
+    PROFILE_SWAP,
+    PROFILE_INPUT_LATENCY,  // Lane key to the swap of the first frame showing it, not a code section
+    PROFILE_SECTION_COUNT
+};
+
+const char* const PROFILE_SECTION_NAMES[PROFILE_SECTION_COUNT] = {
+    "frame", "update", "roadGen", "spawnObstacles", "spawnBuildings", "collision",
+    "render", "cull", "car", "grass", "road", "obstacles", "buildings", "draw", "text", "swap",
+    "inputLatency"
+};
+
+// Counters for the frame being rendered
+struct RenderStats {
+    int drawCalls = 0;
+    long long triangles = 0;
+    int stateChanges = 0;  // Program, texture and VAO binds made by the render queue
+    int uniformWrites = 0;     // glUniform* calls made through GlState
+    int redundantSkipped = 0;  // Binds and uniform writes GlState found already current
+    int visibleObjects = 0, culledObjects = 0;  // Frustum test results
+
+    void Add(long long indexCount, int instances = 1)
+    {
+        drawCalls++;
+        triangles += indexCount / 3 * instances;
+    }
+};
+
+class Profiler {
+public:
+    enum Track { CPU = 0, GPU = 1 };
+    static const int HISTORY = 240;  // Samples kept per section and track for stats
+    static const size_t MAX_TRACE_EVENTS = 2000000;
+
+    struct Stats {
+        int samples = 0;
+        float minMs = 0.0f, avgMs = 0.0f, p99Ms = 0.0f;
+        long long runSamples = 0;  // Every sample since the profiler was created
+        float runAvgMs = 0.0f;
+    };
+
+    Profiler() : epoch(std::chrono::steady_clock::now()) {}
+
+    // Microseconds since the profiler was created
+    double NowUs() const
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void AddSample(ProfileSection section, Track track, double startUs, double durationUs)
+    {
+        History& h = history[track][section];
+        h.ms[h.next] = (float)(durationUs / 1000.0);
+        h.next = (h.next + 1) % HISTORY;
+        if (h.count < HISTORY) h.count++;
+        h.runMs += durationUs / 1000.0;
+        h.runCount++;
+
+        if (tracing && trace.size() < MAX_TRACE_EVENTS)
+            trace.push_back({ section, track, startUs, durationUs });
+    }
+
+    Stats GetStats(ProfileSection section, Track track) const
+    {
+        const History& h = history[track][section];
+        Stats s;
+        s.samples = h.count;
+        s.runSamples = h.runCount;
+        if (h.count == 0) return s;
+        s.runAvgMs = (float)(h.runMs / h.runCount);
+
+        float sorted[HISTORY];
+        std::copy(h.ms, h.ms + h.count, sorted);
+        std::sort(sorted, sorted + h.count);
+        float sum = 0.0f;
+        for (int i = 0; i < h.count; i++) sum += sorted[i];
+        s.minMs = sorted[0];
+        s.avgMs = sum / h.count;
+        s.p99Ms = sorted[std::min(h.count - 1, (int)(h.count * 0.99f))];
+        return s;
+    }
+
+    // Chrome trace capture (chrome://tracing or ui.perfetto.dev)
+    void StartTrace() { trace.clear(); tracing = true; }
+    bool IsTracing() const { return tracing; }
+
+    bool WriteTrace(const std::string& path)
+    {
+        tracing = false;
+        FILE* f = fopen(path.c_str(), "w");
+        if (!f) return false;
+        fprintf(f, "{\"traceEvents\":[\n");
+        fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+        fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+        for (const TraceEvent& e : trace) {
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                PROFILE_SECTION_NAMES[e.section], e.track + 1, e.startUs, e.durationUs);
+        }
+        fprintf(f, "\n]}\n");
+        fclose(f);
+        return true;
+    }
+
+private:
+    struct History {
+        float ms[HISTORY];
+        int next = 0;
+        int count = 0;
+        double runMs = 0.0;
+        long long runCount = 0;
+    };
+    struct TraceEvent {
+        ProfileSection section;
+        Track track;
+        double startUs;
+        double durationUs;
+    };
+
+    std::chrono::steady_clock::time_point epoch;
+    History history[2][PROFILE_SECTION_COUNT];
+    bool tracing = false;
+    std::vector<TraceEvent> trace;
+};
+
+// Times the enclosing block as a CPU sample; a null profiler makes it a no-op
+class ProfileScope {
+public:
+    ProfileScope(Profiler* profiler, ProfileSection section)
+        : profiler(profiler), section(section), startUs(profiler ? profiler->NowUs() : 0.0) {}
+    ~ProfileScope()
+    {
+        if (profiler) profiler->AddSample(section, Profiler::CPU, startUs, profiler->NowUs() - startUs);
+    }
+
+private:
+    Profiler* profiler;
+    ProfileSection section;
+    double startUs;
+};
+
+#endif
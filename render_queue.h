@@ -0,0 +1,140 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader_m.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gl_state.h"
+#include "profiler.h"
+
+// Texture units and sampler names of one mesh, worked out once with the same
+// numbering Mesh::Draw uses (texture_diffuse1, texture_specular1, ...). The
+// sampler locations are resolved once for the program the material is drawn
+// with, by Resolve().
+struct Material {
+    struct Binding {
+        int unit;
+        std::string sampler;
+        unsigned int texture;
+        int location = -1;  // In `program`
+    };
+    std::vector<Binding> bindings;
+    unsigned int program = 0;  // Resolved for; 0 until Resolve()
+
+    void Resolve(GlState& state, const Shader& shader)
+    {
+        for (Binding& b : bindings) b.location = state.Location(shader, b.sampler);
+        program = shader.ID;
+    }
+
+    static Material ForMesh(const Mesh& mesh)
+    {
+        Material m;
+        unsigned int diffuseNr = 1, specularNr = 1, normalNr = 1, heightNr = 1;
+        for (unsigned int i = 0; i < mesh.textures.size(); i++) {
+            std::string name = mesh.textures[i].type;
+            std::string number;
+            if (name == "texture_diffuse") number = std::to_string(diffuseNr++);
+            else if (name == "texture_specular") number = std::to_string(specularNr++);
+            else if (name == "texture_normal") number = std::to_string(normalNr++);
+            else if (name == "texture_height") number = std::to_string(heightNr++);
+            m.bindings.push_back({ (int)i, name + number, mesh.textures[i].id, -1 });
+        }
+        return m;
+    }
+
+    static Material Diffuse(unsigned int texture)
+    {
+        Material m;
+        m.bindings.push_back({ 0, "texture_diffuse1", texture, -1 });
+        return m;
+    }
+};
+
+// One frame's draw submissions. Add() only records them; Submit() sorts by
+// shader, then first texture, then VAO, and issues them through GlState so
+// any program, texture, sampler or VAO change that wouldn't change the bound
+// state is skipped.
+class RenderQueue {
+public:
+    static const int MAX_UNITS = GlState::MAX_UNITS;
+
+    void Clear() { items.clear(); }
+
+    // Plain draw with a "model" uniform
+    void Add(Shader* shader, const Material* material, unsigned int vao, int indexCount, const glm::mat4& model)
+    {
+        items.push_back({ Key(shader, material, vao), shader, material, vao, indexCount, 0, model });
+    }
+
+    // Instanced draw; the instance matrices are already in the VAO's buffer
+    void AddInstanced(Shader* shader, const Material* material, unsigned int vao, int indexCount, int instances)
+    {
+        if (instances <= 0) return;
+        items.push_back({ Key(shader, material, vao), shader, material, vao, indexCount, instances, glm::mat4(1.0f) });
+    }
+
+    // Issues everything queued this frame and returns the number of state
+    // changes made, for the profiler overlay
+    int Submit(RenderStats& stats, GlState& state)
+    {
+        std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.key < b.key; });
+
+        state.Reset();
+        int bindsBefore = state.binds;
+        for (const Item& item : items) {
+            const Shader& shader = *item.shader;
+            state.UseProgram(shader);
+            // By name only for a material queued with a program it wasn't resolved for
+            bool resolved = item.material->program == shader.ID;
+            for (const Material::Binding& b : item.material->bindings) {
+                if (b.unit >= MAX_UNITS) continue;
+                state.SetInt(shader, resolved ? b.location : state.Location(shader, b.sampler), b.unit);
+                state.BindTexture(b.unit, b.texture);
+            }
+            state.BindVertexArray(item.vao);
+            if (item.instances > 0) {
+                glDrawElementsInstanced(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, 0, item.instances);
+                stats.Add(item.indexCount, item.instances);
+            }
+            else {
+                state.SetMat4(shader, state.Uniforms(shader).model, item.model);
+                glDrawElements(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, 0);
+                stats.Add(item.indexCount);
+            }
+        }
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        state.Reset();
+        return state.binds - bindsBefore;
+    }
+
+private:
+    struct Item {
+        uint64_t key;
+        Shader* shader;
+        const Material* material;
+        unsigned int vao;
+        int indexCount;
+        int instances;  // 0 for a plain draw
+        glm::mat4 model;
+    };
+
+    // 16 bits program, 24 bits first texture, 24 bits VAO
+    static uint64_t Key(const Shader* shader, const Material* material, unsigned int vao)
+    {
+        uint64_t texture = material->bindings.empty() ? 0 : material->bindings[0].texture;
+        return ((uint64_t)(shader->ID & 0xFFFF) << 48) | ((texture & 0xFFFFFF) << 24) | (vao & 0xFFFFFF);
+    }
+
+    std::vector<Item> items;  // Keeps its capacity between frames
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "world.h"
+
+// Compact binary log of one run: the world seed, the run length in ticks and
+// every tick that carried lane input. Because the World is deterministic for a
+// given seed and per-tick input, this is enough to replay a run exactly.
+//
+// File layout (little endian):
+//   "CARL" u8 version  u16 ticksPerSecond  u64 seed  u32 tickCount  u32 eventCount
+//   eventCount x { varint tickDelta, u8 flags (1=steerLeft, 2=steerRight) }
+class InputLog {
+public:
+    struct Event {
+        uint32_t tick;
+        uint8_t flags;
+    };
+
+    uint64_t Seed = 0;
+    uint32_t TickCount = 0;  // Length of the recorded run
+    std::vector<Event> Events;
+
+    void Clear(uint64_t seed)
+    {
+        Seed = seed;
+        TickCount = 0;
+        Events.clear();
+    }
+
+    // Call with the index of the tick the input is about to be applied on
+    void Record(uint32_t tick, const SimInput& input)
+    {
+        uint8_t flags = (input.steerLeft ? 1 : 0) | (input.steerRight ? 2 : 0);
+        if (flags) Events.push_back({ tick, flags });
+        if (tick + 1 > TickCount) TickCount = tick + 1;
+    }
+
+    bool Save(const std::string& path) const
+    {
+        std::vector<uint8_t> out;
+        out.insert(out.end(), { 'C', 'A', 'R', 'L', VERSION });
+        putInt(out, ticksPerSecond(), 2);
+        putInt(out, Seed, 8);
+        putInt(out, TickCount, 4);
+        putInt(out, Events.size(), 4);
+        uint32_t last = 0;
+        for (const Event& e : Events) {
+            uint32_t delta = e.tick - last;
+            while (delta >= 0x80) { out.push_back((uint8_t)(delta | 0x80)); delta >>= 7; }
+            out.push_back((uint8_t)delta);
+            out.push_back(e.flags);
+            last = e.tick;
+        }
+
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+        bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+        fclose(f);
+        return ok;
+    }
+
+    bool Load(const std::string& path)
+    {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) return false;
+        std::vector<uint8_t> in;
+        uint8_t chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) in.insert(in.end(), chunk, chunk + n);
+        fclose(f);
+
+        size_t pos = 0;
+        if (in.size() < 23 || in[0] != 'C' || in[1] != 'A' || in[2] != 'R' || in[3] != 'L' || in[4] != VERSION)
+            return false;
+        pos = 5;
+        if (getInt(in, pos, 2) != ticksPerSecond()) return false;  // Recorded with another tick rate
+        Seed = getInt(in, pos, 8);
+        TickCount = (uint32_t)getInt(in, pos, 4);
+        uint32_t count = (uint32_t)getInt(in, pos, 4);
+
+        Events.clear();
+        uint32_t tick = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t delta = 0;
+            for (int shift = 0; ; shift += 7) {
+                if (pos >= in.size() || shift > 28) return false;
+                uint8_t byte = in[pos++];
+                delta |= (uint32_t)(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) break;
+            }
+            if (pos >= in.size()) return false;
+            tick += delta;
+            Events.push_back({ tick, in[pos++] });
+        }
+        return true;
+    }
+
+private:
+    static constexpr uint8_t VERSION = 3;  // 3: chunk contents seeded per chunk index
+
+    static uint16_t ticksPerSecond() { return (uint16_t)(1.0f / SIM_DT + 0.5f); }
+
+    static void putInt(std::vector<uint8_t>& out, uint64_t v, int bytes)
+    {
+        for (int i = 0; i < bytes; i++) out.push_back((uint8_t)(v >> (8 * i)));
+    }
+
+    static uint64_t getInt(const std::vector<uint8_t>& in, size_t& pos, int bytes)
+    {
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; i++) v |= (uint64_t)in[pos++] << (8 * i);
+        return v;
+    }
+};
+
+// Feeds a recorded log back into World::step(), tick by tick
+class InputReplay {
+public:
+    explicit InputReplay(const InputLog* log = nullptr) : log(log) {}
+
+    void Rewind() { cursor = 0; }
+
+    SimInput InputForTick(uint32_t tick)
+    {
+        SimInput input;
+        if (!log) return input;
+        while (cursor < log->Events.size() && log->Events[cursor].tick < tick) cursor++;
+        if (cursor < log->Events.size() && log->Events[cursor].tick == tick) {
+            input.steerLeft = (log->Events[cursor].flags & 1) != 0;
+            input.steerRight = (log->Events[cursor].flags & 2) != 0;
+        }
+        return input;
+    }
+
+    bool Finished(uint32_t tick) const { return !log || tick >= log->TickCount; }
+
+private:
+    const InputLog* log;
+    size_t cursor = 0;
+};
+
+#endif
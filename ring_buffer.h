@@ -0,0 +1,76 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <cassert>
+
+// Fixed-capacity FIFO for the World's Z-ordered streams: items are pushed at
+// the back as the road is generated ahead and popped from the front as the
+// car passes them. Everything lives in one inline array that wraps around, so
+// push and pop are O(1), nothing is allocated after construction, and the
+// live items are at most two contiguous spans.
+template <typename T, int N>
+class RingBuffer {
+public:
+    static const int CAPACITY = N;
+
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == N; }
+    void clear() { head = count = 0; }
+
+    T& operator[](int i) { return items[slot(i)]; }
+    const T& operator[](int i) const { return items[slot(i)]; }
+    T& front() { return items[head]; }
+    const T& front() const { return items[head]; }
+    T& back() { return items[slot(count - 1)]; }
+    const T& back() const { return items[slot(count - 1)]; }
+
+    // The caller checks full() first
+    void push_back(const T& item)
+    {
+        assert(count < N);
+        items[slot(count)] = item;
+        count++;
+    }
+
+    void pop_front(int n = 1)
+    {
+        assert(n >= 0 && n <= count);
+        head = slot(n);
+        count -= n;
+    }
+
+    // Live items oldest first as up to two runs; returns how many there are
+    int spans(const T* data[2], int sizes[2]) const
+    {
+        int first = count < N - head ? count : N - head;
+        data[0] = items + head;
+        sizes[0] = first;
+        data[1] = items;
+        sizes[1] = count - first;
+        return count == 0 ? 0 : sizes[1] > 0 ? 2 : 1;
+    }
+
+    template <typename Ring, typename Item>
+    struct Iterator {
+        Ring* ring;
+        int i;
+        Item& operator*() const { return (*ring)[i]; }
+        Item* operator->() const { return &(*ring)[i]; }
+        Iterator& operator++() { i++; return *this; }
+        bool operator!=(const Iterator& other) const { return i != other.i; }
+    };
+    Iterator<RingBuffer, T> begin() { return { this, 0 }; }
+    Iterator<RingBuffer, T> end() { return { this, count }; }
+    Iterator<const RingBuffer, const T> begin() const { return { this, 0 }; }
+    Iterator<const RingBuffer, const T> end() const { return { this, count }; }
+
+private:
+    T items[N];
+    int head = 0;   // Array index of the oldest item
+    int count = 0;
+
+    int slot(int i) const { return (head + i) % N; }
+};
+
+#endif
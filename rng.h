@@ -0,0 +1,49 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+// PCG32 (pcg-random.org): small, fast and fully determined by (seed, stream),
+// so each subsystem can own an independent, reproducible sequence.
+class Rng {
+public:
+    explicit Rng(uint64_t seed = 0, uint64_t stream = 0) { Seed(seed, stream); }
+
+    void Seed(uint64_t seed, uint64_t stream = 0)
+    {
+        state = 0;
+        inc = (stream << 1u) | 1u;
+        Next();
+        state += seed;
+        Next();
+    }
+
+    uint32_t Next()
+    {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = (uint32_t)(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    // Two statements, so the high half is always drawn first
+    uint64_t Next64()
+    {
+        uint32_t hi = Next();
+        uint32_t lo = Next();
+        return ((uint64_t)hi << 32) | lo;
+    }
+
+    // Uniform in [0, n)
+    int NextInt(int n) { return (int)(((uint64_t)Next() * (uint32_t)n) >> 32); }
+
+    // Uniform in [0, 1)
+    float NextFloat() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+
+private:
+    uint64_t state;
+    uint64_t inc;
+};
+
+#endif
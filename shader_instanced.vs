@@ -0,0 +1,27 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in mat4 aInstanceMatrix;
+
+out vec2 TexCoords;
+out vec3 FragPos;
+out float FragDepth;
+
+// Camera constants shared by the scene shaders (FrameUniforms in gl_state.h)
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec4 cameraPos;
+} frame;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    FragPos = vec3(aInstanceMatrix * vec4(aPos, 1.0));
+    
+    vec4 viewPos = frame.view * aInstanceMatrix * vec4(aPos, 1.0);
+    FragDepth = -viewPos.z;
+    
+    gl_Position = frame.projection * viewPos;
+}
\ No newline at end of file
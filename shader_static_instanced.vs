@@ -0,0 +1,34 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in int aInstanceSlot;
+
+out vec2 TexCoords;
+out vec3 FragPos;
+out float FragDepth;
+
+// Camera constants shared by the scene shaders (FrameUniforms in gl_state.h)
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec4 cameraPos;
+} frame;
+
+// Model matrices of static instances, one per slot as four RGBA32F texels
+uniform samplerBuffer instanceMatrices;
+
+void main()
+{
+    int base = aInstanceSlot * 4;
+    mat4 model = mat4(texelFetch(instanceMatrices, base), texelFetch(instanceMatrices, base + 1),
+        texelFetch(instanceMatrices, base + 2), texelFetch(instanceMatrices, base + 3));
+
+    TexCoords = aTexCoords;
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    
+    vec4 viewPos = frame.view * model * vec4(aPos, 1.0);
+    FragDepth = -viewPos.z;
+    
+    gl_Position = frame.projection * viewPos;
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "world.h"
+
+// What the renderer needs of one simulation tick, copied out of the World so
+// it can be drawn while the simulation moves on. The car is kept at this
+// tick and the one before, so frames between ticks can interpolate it.
+struct WorldSnapshot {
+    unsigned long long tick = 0;
+    double time = 0.0;  // SimThread::Clock() when published
+    glm::vec3 carPos = glm::vec3(0.0f), lastCarPos = glm::vec3(0.0f);
+    float carRotationY = 0.0f, lastCarRotationY = 0.0f;
+    float speed = 0.0f;
+    float distanceTraveled = 0.0f;
+    int totalScore = 0;
+    bool gameOver = false;
+    float segmentSize = 20.0f;
+    RingBuffer<RoadSegment, MAX_ROAD_CHUNKS> roadSegments;
+    ObstaclePool obstacles;
+    BuildingList buildings;
+    // Newest player input the World has consumed, for input latency
+    uint64_t inputId = 0;
+    double inputTime = 0.0;
+
+    void Capture(const World& world)
+    {
+        tick = world.tickCount;
+        carPos = world.carPosition();
+        lastCarPos = world.lastCarPosition();
+        carRotationY = world.carRotationY;
+        lastCarRotationY = world.lastCarRotationY;
+        speed = world.speed;
+        distanceTraveled = world.distanceTraveled;
+        totalScore = world.totalScore;
+        gameOver = world.gameOver;
+        segmentSize = world.segmentSize;
+        roadSegments = world.roadSegments;
+        obstacles = world.obstacles;
+        buildings = world.buildings;
+    }
+
+    // alpha is how far past this tick the frame is, in ticks (0..1)
+    glm::vec3 CarPosition(float alpha) const { return glm::mix(lastCarPos, carPos, alpha); }
+    float CarRotationY(float alpha) const { return lastCarRotationY + (carRotationY - lastCarRotationY) * alpha; }
+};
+
+// Hands the newest value from one producer to one consumer without either
+// waiting: the producer fills Back() and publishes it, the consumer takes
+// whatever was published last, and the third slot means neither ever writes
+// the one the other is using. Values the consumer was too slow for are
+// skipped.
+template <typename T>
+class TripleBuffer {
+public:
+    T& Back() { return slots[back]; }
+    const T& Front() const { return slots[front]; }
+
+    void Publish()
+    {
+        back = ready.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Moves Front() to the newest published value; false if there is none
+    // newer than the current one
+    bool Acquire()
+    {
+        if (!(ready.load(std::memory_order_acquire) & FRESH)) return false;
+        front = ready.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+private:
+    static const int INDEX = 3, FRESH = 4;
+    T slots[3];
+    int back = 0, front = 1;
+    std::atomic<int> ready{ 2 };
+};
+
+// Runs a tick function on its own thread in real time, one call every dt
+// seconds. Each call holds `mutex`, so another thread can change what the
+// ticks work on by taking it between them. After a stall (more than
+// maxBacklog behind) the missed time is dropped rather than caught up, like
+// FixedTimestep does.
+class SimThread {
+public:
+    std::mutex mutex;
+
+    ~SimThread() { Stop(); }
+
+    // Seconds on the steady clock, comparable across threads
+    static double Clock()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Start(float dt, std::function<void()> tickFn, float maxBacklog = 0.25f)
+    {
+        Stop();
+        tick = tickFn;
+        running.store(true, std::memory_order_release);
+        worker = std::thread(&SimThread::Run, this, dt, maxBacklog);
+    }
+
+    void Stop()
+    {
+        running.store(false, std::memory_order_release);
+        if (worker.joinable()) worker.join();
+    }
+
+    // While paused no ticks run and no time is owed for them
+    void SetPaused(bool value) { paused.store(value, std::memory_order_release); }
+
+private:
+    std::function<void()> tick;
+    std::thread worker;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> paused{ true };
+
+    void Run(float dt, float maxBacklog)
+    {
+        typedef std::chrono::steady_clock SteadyClock;
+        const SteadyClock::duration step = std::chrono::duration_cast<SteadyClock::duration>(std::chrono::duration<float>(dt));
+        const SteadyClock::duration backlog = std::chrono::duration_cast<SteadyClock::duration>(std::chrono::duration<float>(maxBacklog));
+        SteadyClock::time_point next = SteadyClock::now();
+        while (running.load(std::memory_order_acquire)) {
+            SteadyClock::time_point now = SteadyClock::now();
+            if (paused.load(std::memory_order_acquire)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                next = now;
+                continue;
+            }
+            if (now < next) {
+                std::this_thread::sleep_until(next);
+                continue;
+            }
+            if (now - next > backlog) next = now;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tick();
+            }
+            next += step;
+        }
+    }
+};
+
+#endif
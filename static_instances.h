@@ -0,0 +1,95 @@
+#ifndef STATIC_INSTANCES_H
+#define STATIC_INSTANCES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+
+// Model matrices of instances that never move, uploaded once when they
+// appear into a texture buffer that the vertex shader reads by slot, so
+// drawing them needs no per-frame matrix work. Instances come and go in FIFO
+// order (added ahead of the car, dropped behind it), so the storage is a
+// ring: the i-th live instance is in Slot(i).
+class StaticInstances {
+public:
+    static const int TEXTURE_UNIT = 8;  // Above the units RenderQueue binds
+
+    void Init(int initialCapacity = 256)
+    {
+        capacity = initialCapacity;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glGenTextures(1, &texture);
+        Bind();
+    }
+
+    int Size() const { return count; }
+    int Slot(int i) const { return (first + i) % capacity; }
+
+    void Append(const glm::mat4* matrices, int n)
+    {
+        if (count + n > capacity) Grow(count + n);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        for (int i = 0; i < n; ) {
+            // Up to the end of the ring per upload
+            int slot = Slot(count + i);
+            int run = std::min(n - i, capacity - slot);
+            glBufferSubData(GL_TEXTURE_BUFFER, slot * sizeof(glm::mat4), run * sizeof(glm::mat4), &matrices[i]);
+            i += run;
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        count += n;
+    }
+
+    // Drops the n oldest instances
+    void Retire(int n)
+    {
+        n = std::min(n, count);
+        first = (first + n) % capacity;
+        count -= n;
+    }
+
+    void Clear() { first = count = 0; }
+
+    // Attaches the buffer to TEXTURE_UNIT for the "instanceMatrices" sampler
+    void Bind() const
+    {
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    unsigned int buffer = 0, texture = 0;
+    int capacity = 0;
+    int first = 0, count = 0;
+
+    // Moves the live instances to the start of a bigger buffer
+    void Grow(int needed)
+    {
+        int newCapacity = capacity;
+        while (newCapacity < needed) newCapacity *= 2;
+        unsigned int newBuffer;
+        glGenBuffers(1, &newBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        int head = std::min(count, capacity - first);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, first * sizeof(glm::mat4), 0, head * sizeof(glm::mat4));
+        if (count > head)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, head * sizeof(glm::mat4), (count - head) * sizeof(glm::mat4));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        buffer = newBuffer;
+        capacity = newCapacity;
+        first = 0;
+        Bind();
+    }
+};
+
+#endif
@@ -0,0 +1,244 @@
+#ifndef TEXT_RENDERER_H
+#define TEXT_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader_m.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Batched FreeType text. The first 128 ASCII glyphs are packed into a single
+// atlas texture; RenderText() only appends quads to a CPU vertex array and
+// Flush() draws everything queued this frame with one call.
+class TextRenderer {
+public:
+    struct Glyph {
+        glm::ivec2 Size;
+        glm::ivec2 Bearing;
+        float Advance;    // In pixels (FreeType's 1/64 units already shifted)
+        glm::vec2 UvMin;  // Top-left of the glyph in the atlas
+        glm::vec2 UvMax;
+    };
+
+    Glyph Glyphs[128];
+    unsigned int AtlasTexture = 0;
+
+    // Rasterises the font and uploads the atlas; needs a current GL context
+    bool Load(const std::string& fontPath, unsigned int pixelSize)
+    {
+        FT_Library ft;
+        if (FT_Init_FreeType(&ft)) {
+            std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+            return false;
+        }
+        FT_Face face;
+        if (FT_New_Face(ft, fontPath.c_str(), 0, &face)) {
+            std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
+            FT_Done_FreeType(ft);
+            return false;
+        }
+        FT_Set_Pixel_Sizes(face, 0, pixelSize);
+
+        // Rasterise every glyph first so the atlas can be sized in one go
+        std::vector<std::vector<unsigned char>> bitmaps(128);
+        for (unsigned char c = 0; c < 128; c++) {
+            Glyph& g = Glyphs[c];
+            g = Glyph();
+            if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
+                std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
+                continue;
+            }
+            FT_Bitmap& bmp = face->glyph->bitmap;
+            g.Size = glm::ivec2(bmp.width, bmp.rows);
+            g.Bearing = glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top);
+            g.Advance = (float)(face->glyph->advance.x >> 6);
+            bitmaps[c].resize(bmp.width * bmp.rows);
+            for (unsigned int row = 0; row < bmp.rows; row++)
+                for (unsigned int col = 0; col < bmp.width; col++)
+                    bitmaps[c][row * bmp.width + col] = bmp.buffer[row * bmp.pitch + col];
+        }
+        FT_Done_Face(face);
+        FT_Done_FreeType(ft);
+
+        // Shelf packing with a 1px gutter so linear filtering doesn't bleed
+        const int atlasWidth = 512;
+        const int pad = 1;
+        std::vector<glm::ivec2> origins(128);
+        int penX = pad, penY = pad, shelfHeight = 0;
+        for (int c = 0; c < 128; c++) {
+            const Glyph& g = Glyphs[c];
+            if (penX + g.Size.x + pad > atlasWidth) {
+                penX = pad;
+                penY += shelfHeight + pad;
+                shelfHeight = 0;
+            }
+            origins[c] = glm::ivec2(penX, penY);
+            penX += g.Size.x + pad;
+            if (g.Size.y > shelfHeight) shelfHeight = g.Size.y;
+        }
+        int atlasHeight = 1;
+        while (atlasHeight < penY + shelfHeight + pad) atlasHeight *= 2;
+
+        std::vector<unsigned char> pixels(atlasWidth * atlasHeight, 0);
+        for (int c = 0; c < 128; c++) {
+            Glyph& g = Glyphs[c];
+            for (int row = 0; row < g.Size.y; row++)
+                for (int col = 0; col < g.Size.x; col++)
+                    pixels[(origins[c].y + row) * atlasWidth + origins[c].x + col] = bitmaps[c][row * g.Size.x + col];
+            g.UvMin = glm::vec2((float)origins[c].x / atlasWidth, (float)origins[c].y / atlasHeight);
+            g.UvMax = glm::vec2((float)(origins[c].x + g.Size.x) / atlasWidth, (float)(origins[c].y + g.Size.y) / atlasHeight);
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glGenTextures(1, &AtlasTexture);
+        glBindTexture(GL_TEXTURE_2D, AtlasTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // Vertex layout: vec2 pos, vec2 uv, vec3 color
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(4 * sizeof(float)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+        return true;
+    }
+
+    const Glyph& GetGlyph(char c) const { return Glyphs[(unsigned char)c & 127]; }
+
+    float GetTextWidth(const std::string& text, float scale) const
+    {
+        float width = 0.0f;
+        for (char c : text)
+            width += GetGlyph(c).Advance * scale;
+        return width;
+    }
+
+    // Queues text with its baseline starting at (x, y); drawn by Flush()
+    void RenderText(const std::string& text, float x, float y, float scale, glm::vec3 color)
+    {
+        BuildText(text, x, y, scale, color, vertices);
+    }
+
+    // Queues quads prepared earlier with BuildText()
+    void Queue(const std::vector<float>& prebuilt)
+    {
+        vertices.insert(vertices.end(), prebuilt.begin(), prebuilt.end());
+    }
+
+    // Appends the quads for text to out without queueing them
+    void BuildText(const std::string& text, float x, float y, float scale, glm::vec3 color, std::vector<float>& out) const
+    {
+        for (char c : text) {
+            const Glyph& ch = GetGlyph(c);
+
+            float xpos = x + ch.Bearing.x * scale;
+            float ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
+            float w = ch.Size.x * scale;
+            float h = ch.Size.y * scale;
+
+            float quad[6][FLOATS_PER_VERTEX] = {
+                { xpos,     ypos + h,   ch.UvMin.x, ch.UvMin.y, color.x, color.y, color.z },
+                { xpos,     ypos,       ch.UvMin.x, ch.UvMax.y, color.x, color.y, color.z },
+                { xpos + w, ypos,       ch.UvMax.x, ch.UvMax.y, color.x, color.y, color.z },
+
+                { xpos,     ypos + h,   ch.UvMin.x, ch.UvMin.y, color.x, color.y, color.z },
+                { xpos + w, ypos,       ch.UvMax.x, ch.UvMax.y, color.x, color.y, color.z },
+                { xpos + w, ypos + h,   ch.UvMax.x, ch.UvMin.y, color.x, color.y, color.z }
+            };
+            out.insert(out.end(), &quad[0][0], &quad[0][0] + 6 * FLOATS_PER_VERTEX);
+            x += ch.Advance * scale;
+        }
+    }
+
+    // Draws everything queued since the last flush in a single call and
+    // returns the number of vertices drawn
+    int Flush(Shader& shader)
+    {
+        if (vertices.empty()) return 0;
+
+        shader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, AtlasTexture);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        // Grow the buffer only when a frame needs more; otherwise just overwrite
+        if (vertices.size() > bufferCapacity) {
+            bufferCapacity = vertices.capacity();
+            glBufferData(GL_ARRAY_BUFFER, bufferCapacity * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), vertices.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        int vertexCount = (int)(vertices.size() / FLOATS_PER_VERTEX);
+        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        vertices.clear();  // Keeps capacity for the next frame
+        return vertexCount;
+    }
+
+private:
+    static const int FLOATS_PER_VERTEX = 7;
+    unsigned int VAO = 0, VBO = 0;
+    size_t bufferCapacity = 0;
+    std::vector<float> vertices;
+};
+
+// Retained text: the string, its width and its quads are kept between frames
+// and only rebuilt by SetText() when the text actually changes.
+class TextLabel {
+public:
+    enum Anchor { LEFT, CENTER, RIGHT };  // Which part of the text sits on x
+
+    float X = 0.0f, Y = 0.0f, Scale = 1.0f;
+    glm::vec3 Color = glm::vec3(1.0f);
+    Anchor Align = LEFT;
+
+    TextLabel() {}
+    TextLabel(float x, float y, float scale, glm::vec3 color, Anchor align = LEFT)
+        : X(x), Y(y), Scale(scale), Color(color), Align(align) {}
+
+    // Returns true if the text changed and the label was rebuilt
+    bool SetText(const TextRenderer& renderer, const char* text)
+    {
+        if (built && this->text == text) return false;
+        this->text = text;  // Reuses the string's capacity
+        width = renderer.GetTextWidth(this->text, Scale);
+
+        float x = X;
+        if (Align == CENTER) x -= width / 2.0f;
+        else if (Align == RIGHT) x -= width;
+        vertices.clear();
+        renderer.BuildText(this->text, x, Y, Scale, Color, vertices);
+        built = true;
+        return true;
+    }
+
+    void Draw(TextRenderer& renderer) const { renderer.Queue(vertices); }
+
+    const std::string& GetText() const { return text; }
+    float GetWidth() const { return width; }
+
+private:
+    std::string text;
+    float width = 0.0f;
+    std::vector<float> vertices;
+    bool built = false;
+};
+
+#endif
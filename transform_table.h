@@ -0,0 +1,33 @@
+#ifndef TRANSFORM_TABLE_H
+#define TRANSFORM_TABLE_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Model matrices of each entity variant (obstacle type, building type and
+// side) placed at the origin, worked out once. An entity's model matrix is
+// its variant's entry with its position added to the translation column, so
+// placing a whole array of entities is a branch-free copy-and-add loop with
+// no per-object rotate/scale maths.
+class TransformTable {
+public:
+    std::vector<glm::mat4> entries;  // Indexed by variant
+
+    // out[i] = entries[variant[i]] moved by (x[i], 0, z[i])
+    void Place(const int* variant, const float* x, const float* z, size_t count, glm::mat4* out) const
+    {
+        if (count == 0) return;
+        const float* table = &entries[0][0][0];
+        float* dst = &out[0][0][0];
+        for (size_t i = 0; i < count; i++) {
+            const float* src = table + variant[i] * 16;
+            float* m = dst + i * 16;
+            for (int k = 0; k < 16; k++) m[k] = src[k];
+            m[12] += x[i];
+            m[14] += z[i];
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,503 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "profiler.h"
+#include "chunk_stream.h"
+#include "ring_buffer.h"
+
+// Gameplay simulation. Nothing in here touches GL or GLFW, so a World can be
+// stepped without a window (soak tests, benchmarks, replays).
+
+// Simulation tick length used by the game loop and the headless runner
+const float SIM_DT = 1.0f / 120.0f;
+
+struct RoadSegment { float zStart; };
+
+struct Obstacle {
+    glm::vec3 pos;
+    int type; // 0=StopSign, 1=Cone, 2=Barrel
+    int lane;
+};
+
+// Collision footprints on the XZ plane as (x, z) half extents, measured from
+// each model at the scale it is drawn with
+const glm::vec2 OBSTACLE_HALF_EXTENTS[3] = {
+    { 0.4f, 0.4f },    // StopSign (1.0x)
+    { 0.35f, 0.35f },  // Cone (0.6x)
+    { 0.6f, 0.6f },    // Barrel (2.0x)
+};
+const float OBSTACLE_MAX_HALF_EXTENT = 0.6f;
+const glm::vec2 CAR_HALF_EXTENTS = { 0.9f, 2.1f };
+
+// Most road chunks the World keeps loaded; sizes the fixed-capacity streams
+const int MAX_ROAD_CHUNKS = 512;
+
+// Obstacle storage, one ring per field (obstacles sit on the ground, so
+// there is no y). Chunks spawn their obstacles in Z order, so the ones the
+// car has passed are always at the front. Slots are ring positions, 0 being
+// the nearest. The rings are public for batch readers; only the pool writes
+// them.
+class ObstaclePool {
+public:
+    static const int CAPACITY = MAX_ROAD_CHUNKS;  // At most one per chunk
+
+    RingBuffer<float, CAPACITY> x, z;
+    RingBuffer<int, CAPACITY> type, lane;
+
+    int size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+    void clear() { x.clear(); z.clear(); type.clear(); lane.clear(); }
+    Obstacle operator[](int slot) const { return { glm::vec3(x[slot], 0.0f, z[slot]), type[slot], lane[slot] }; }
+
+    void spawn(const Obstacle& obs)
+    {
+        // At the ceiling, give up the obstacle furthest behind
+        if (x.full()) pop(1);
+        x.push_back(obs.pos.x);
+        z.push_back(obs.pos.z);
+        type.push_back(obs.type);
+        lane.push_back(obs.lane);
+    }
+
+    // Recycle every obstacle with z < minZ, returns how many were freed
+    int retireBehind(float minZ)
+    {
+        int freed = 0;
+        while (freed < z.size() && z[freed] < minZ) freed++;
+        pop(freed);
+        return freed;
+    }
+
+private:
+    void pop(int n) { x.pop_front(n); z.pop_front(n); type.pop_front(n); lane.pop_front(n); }
+};
+
+// Broad phase for car-vs-obstacle tests: pool slots grouped per lane and
+// sorted by Z, so a query only visits the few obstacles within reach.
+class CollisionIndex {
+public:
+    void rebuild(const ObstaclePool& pool)
+    {
+        counts[0] = counts[1] = counts[2] = 0;
+        for (int slot = 0; slot < pool.size(); slot++) {
+            int lane = pool.lane[slot];
+            Entry* list = entries[lane];
+            // Insertion sort; a lane rarely holds more than a handful
+            int i = counts[lane]++;
+            while (i > 0 && list[i - 1].z > pool.z[slot]) {
+                list[i] = list[i - 1];
+                i--;
+            }
+            list[i] = { pool.z[slot], slot };
+        }
+    }
+
+    // Calls fn(slot) for obstacles in lanes whose centre lies in [minX, maxX]
+    // and with z in [minZ, maxZ], until fn returns true. Returns whether it did.
+    template <typename Fn>
+    bool query(const glm::vec3 lanes[3], float minX, float maxX, float minZ, float maxZ, Fn fn) const
+    {
+        for (int lane = 0; lane < 3; lane++) {
+            if (lanes[lane].x < minX || lanes[lane].x > maxX)
+                continue;
+            const Entry* first = entries[lane];
+            const Entry* last = first + counts[lane];
+            const Entry* it = std::lower_bound(first, last, minZ,
+                [](const Entry& e, float z) { return e.z < z; });
+            for (; it != last && it->z <= maxZ; ++it)
+                if (fn(it->slot)) return true;
+        }
+        return false;
+    }
+
+private:
+    struct Entry { float z; int slot; };
+    Entry entries[3][ObstaclePool::CAPACITY];
+    int counts[3] = { 0, 0, 0 };
+};
+
+struct Building {
+    glm::vec3 pos;
+    int type; // 0=b2,1=b3,2=b4,3=b5
+    bool leftSide;
+};
+
+// Buildings in Z order, one ring per field like ObstaclePool. They are added
+// at the far end and dropped from the near end as chunks come and go.
+class BuildingList {
+public:
+    static const int CAPACITY = MAX_ROAD_CHUNKS * 2;  // A pair per chunk at most
+
+    RingBuffer<float, CAPACITY> x, z;
+    RingBuffer<int, CAPACITY> type;
+    RingBuffer<unsigned char, CAPACITY> leftSide;
+    // Id of the building at index 0. Ids count up for as long as the list
+    // lives (clear() included), so a renderer can follow what was added and
+    // dropped since it last looked.
+    uint64_t firstId = 0;
+
+    int size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+    Building operator[](int i) const { return { glm::vec3(x[i], 0.0f, z[i]), type[i], leftSide[i] != 0 }; }
+
+    void clear()
+    {
+        firstId += x.size();
+        x.clear(); z.clear(); type.clear(); leftSide.clear();
+    }
+
+    // At the ceiling the nearest building is dropped
+    void push_back(const Building& b)
+    {
+        if (x.full()) pop(1);
+        x.push_back(b.pos.x);
+        z.push_back(b.pos.z);
+        type.push_back(b.type);
+        leftSide.push_back(b.leftSide ? 1 : 0);
+    }
+
+    // Drops the buildings with z < minZ
+    void eraseBefore(float minZ)
+    {
+        int n = 0;
+        while (n < z.size() && z[n] < minZ) n++;
+        pop(n);
+    }
+
+private:
+    void pop(int n)
+    {
+        firstId += n;
+        x.pop_front(n); z.pop_front(n); type.pop_front(n); leftSide.pop_front(n);
+    }
+};
+
+// Lane change requests for a single tick (edge-triggered, already debounced)
+struct SimInput {
+    bool steerLeft = false;   // A: towards lane 2
+    bool steerRight = false;  // D: towards lane 0
+};
+
+class World {
+public:
+    glm::vec3 lanes[3] = { {-3.0f,0.0f,0.0f}, {0.0f,0.0f,0.0f}, {3.0f,0.0f,0.0f} };
+    float segmentSize = 20.0f;     // Length of one road chunk
+    int roadChunksAhead = 15;      // Chunks kept loaded past the car's chunk (the view distance); capped by MAX_ROAD_CHUNKS
+    int roadChunksBehind = 2;      // ...and before it, past the third-person camera
+    float firstObstacleZ = 80.0f;  // Chunks starting before this get no obstacles, so a run starts clear
+    int buildingChunkInterval = 3; // A pair of buildings every this many chunks
+    float baseSpeed = 20.0f;       // Speed at the start of a run
+    float laneChangeSpeed = 2.0f;  // Lane changes per second
+    float obstacleRetireDistance = 20.0f;  // Behind the car, past the third-person camera
+    bool collisionsEnabled = true;  // Off for soak runs that must never end
+    Profiler* profiler = nullptr;   // Optional, times the step sub-sections
+    ChunkStream* chunkStream = nullptr;  // Optional, generates chunks ahead on a worker thread
+    uint64_t seed = 0;  // Spawn sequences are a pure function of this; applied by reset()
+
+    // Car state
+    int playerLane;
+    int targetLane;
+    bool isChangingLane;
+    float laneChangeProgress;
+    float currentCarX;
+    float carRotationY;
+    float carZ;
+    float speed;
+    int lastSpeedIncreaseScore;  // Score threshold of the last speed-up
+    // Car state before the latest step, for render interpolation
+    float lastCarX, lastCarZ, lastCarRotationY;
+
+    RingBuffer<RoadSegment, MAX_ROAD_CHUNKS> roadSegments;  // One per loaded chunk, in Z order
+    ObstaclePool obstacles;
+    BuildingList buildings;
+
+    float distanceTraveled;
+    int totalScore;
+    bool gameOver;
+    unsigned long long tickCount;  // Ticks stepped since reset()
+
+    World() { reset(); }
+
+    void reset()
+    {
+        playerLane = 1;
+        targetLane = 1;
+        isChangingLane = false;
+        laneChangeProgress = 0.0f;
+        currentCarX = 0.0f;
+        carRotationY = 0.0f;
+        carZ = 0.0f;
+        speed = baseSpeed;
+        lastSpeedIncreaseScore = 0;
+        lastCarX = lastCarZ = lastCarRotationY = 0.0f;
+        obstacles.clear();
+        collisionIndexDirty = true;
+        buildings.clear();
+        distanceTraveled = 0.0f;
+        totalScore = 0;
+        gameOver = false;
+        tickCount = 0;
+
+        roadSegments.clear();
+        nextChunk = -roadChunksBehind;
+        if (chunkStream) chunkStream->Start(chunkRules(), nextChunk);
+        streamRoad();
+        spawnObstacles();
+        spawnBuildings();
+    }
+
+    // Advance the simulation by dt seconds
+    void step(float dt, const SimInput& input)
+    {
+        tickCount++;
+        lastCarX = currentCarX;
+        lastCarZ = carZ;
+        lastCarRotationY = carRotationY;
+        applyInput(input);
+        if (gameOver)
+            return;
+
+        float prevCarX = currentCarX;
+        float prevCarZ = carZ;
+        carZ += speed * dt;
+        distanceTraveled = carZ / 10.0f;
+
+        // Update score based on distance (10 points per meter)
+        totalScore = (int)(distanceTraveled * 10);
+
+        // Increase speed by 10% every 500 points
+        int currentThreshold = (totalScore / 500) * 500;
+        if (currentThreshold > lastSpeedIncreaseScore && currentThreshold > 0) {
+            lastSpeedIncreaseScore = currentThreshold;
+            speed = baseSpeed * (1.0f + (currentThreshold / 500) * 0.1f);
+        }
+
+        updateLaneChange(dt);
+        // Before spawning, which also retires obstacles the car just swept past
+        {
+            ProfileScope scope(profiler, PROFILE_COLLISION);
+            checkCollisions(prevCarX, prevCarZ);
+        }
+        {
+            ProfileScope scope(profiler, PROFILE_ROAD_GEN);
+            streamRoad();
+        }
+        {
+            ProfileScope scope(profiler, PROFILE_SPAWN_OBSTACLES);
+            spawnObstacles();
+        }
+        {
+            ProfileScope scope(profiler, PROFILE_SPAWN_BUILDINGS);
+            spawnBuildings();
+        }
+    }
+
+    glm::vec3 carPosition() const { return glm::vec3(currentCarX, 0.0f, carZ); }
+    glm::vec3 lastCarPosition() const { return glm::vec3(lastCarX, 0.0f, lastCarZ); }
+
+    ChunkRules chunkRules() const
+    {
+        ChunkRules rules;
+        rules.seed = seed;
+        rules.segmentSize = segmentSize;
+        rules.firstObstacleZ = firstObstacleZ;
+        rules.buildingChunkInterval = buildingChunkInterval;
+        return rules;
+    }
+
+    // FNV-1a over the gameplay state, for checking that a replay matches
+    uint64_t stateHash() const
+    {
+        uint64_t h = 1469598103934665603ULL;
+        auto mix = [&h](const void* data, size_t size) {
+            const unsigned char* p = (const unsigned char*)data;
+            for (size_t i = 0; i < size; i++) { h ^= p[i]; h *= 1099511628211ULL; }
+        };
+        mix(&tickCount, sizeof(tickCount));
+        mix(&carZ, sizeof(carZ));
+        mix(&currentCarX, sizeof(currentCarX));
+        mix(&speed, sizeof(speed));
+        mix(&totalScore, sizeof(totalScore));
+        mix(&gameOver, sizeof(gameOver));
+        for (int i = 0; i < obstacles.size(); i++) {
+            Obstacle obs = obstacles[i];
+            mix(&obs.pos, sizeof(obs.pos));
+            mix(&obs.type, sizeof(obs.type));
+        }
+        for (int i = 0; i < buildings.size(); i++) {
+            Building b = buildings[i];
+            mix(&b.pos, sizeof(b.pos));
+            mix(&b.type, sizeof(b.type));
+        }
+        return h;
+    }
+
+private:
+    long long nextChunk;  // Index of the next chunk to load; chunk i starts at i * segmentSize
+    std::vector<ChunkContents> newChunks;  // Loaded by the last streamRoad(), waiting to spawn
+    CollisionIndex collisionIndex;
+    bool collisionIndexDirty;
+
+    void applyInput(const SimInput& input)
+    {
+        // Only allow lane change if not currently changing lanes
+        if (isChangingLane || gameOver)
+            return;
+        if (input.steerRight && playerLane > 0) {
+            targetLane = playerLane - 1;
+            isChangingLane = true;
+            laneChangeProgress = 0.0f;
+        }
+        else if (input.steerLeft && playerLane < 2) {
+            targetLane = playerLane + 1;
+            isChangingLane = true;
+            laneChangeProgress = 0.0f;
+        }
+    }
+
+    void updateLaneChange(float dt)
+    {
+        if (!isChangingLane) {
+            currentCarX = lanes[playerLane].x;
+            carRotationY = 0.0f;
+            return;
+        }
+
+        laneChangeProgress += dt * laneChangeSpeed;
+
+        if (laneChangeProgress >= 1.0f) {
+            laneChangeProgress = 1.0f;
+            isChangingLane = false;
+            playerLane = targetLane;
+            carRotationY = 0.0f;
+        }
+
+        // Smooth interpolation for position
+        float startX = lanes[playerLane].x;
+        float endX = lanes[targetLane].x;
+        currentCarX = startX + (endX - startX) * laneChangeProgress;
+
+        // Rotation: 0 -> 15 -> 0 degrees
+        float maxRotationAngle = 15.0f;
+        if (laneChangeProgress < 0.5f)
+            carRotationY = (laneChangeProgress * 2.0f) * maxRotationAngle;
+        else
+            carRotationY = (2.0f - laneChangeProgress * 2.0f) * maxRotationAngle;
+
+        // Apply direction (left is negative, right is positive)
+        if (targetLane < playerLane)
+            carRotationY = -carRotationY;
+    }
+
+    void spawnObstacles()
+    {
+        for (const ChunkContents& c : newChunks) {
+            if (!c.hasObstacle)
+                continue;
+            glm::vec3 pos = lanes[c.obstacleLane] + glm::vec3(0.0f, 0.0f, c.obstacleZ);
+            obstacles.spawn({ pos, c.obstacleType, c.obstacleLane });
+            collisionIndexDirty = true;
+        }
+        if (obstacles.retireBehind(carZ - obstacleRetireDistance) > 0)
+            collisionIndexDirty = true;
+    }
+
+    // Buildings go when their chunk does
+    void spawnBuildings()
+    {
+        for (const ChunkContents& c : newChunks) {
+            if (!c.hasBuildings)
+                continue;
+            buildings.push_back({ glm::vec3(-16.0f, 0.0f, c.buildingZ), c.leftBuildingType, true });
+            buildings.push_back({ glm::vec3(16.0f, 0.0f, c.buildingZ), c.rightBuildingType, false });
+        }
+        float minZ = roadSegments.empty() ? carZ : roadSegments.front().zStart;
+        buildings.eraseBefore(minZ);
+    }
+
+    // Loads every chunk from roadChunksBehind before the car's chunk to
+    // roadChunksAhead after it and drops the rest, however far the car went
+    // this tick; chunks the car passed entirely within one tick are skipped.
+    // The contents of loaded chunks come from the chunk stream when there is
+    // one, so the sim thread normally does no generation work.
+    void streamRoad()
+    {
+        long long carChunk = (long long)std::floor(carZ / segmentSize);
+        long long first = carChunk - roadChunksBehind;
+        long long last = carChunk + std::min(roadChunksAhead, MAX_ROAD_CHUNKS - 1 - roadChunksBehind);
+
+        while (!roadSegments.empty() && roadSegments.front().zStart < first * segmentSize)
+            roadSegments.pop_front();
+        newChunks.clear();
+        nextChunk = std::max(nextChunk, first);
+        for (; nextChunk <= last; nextChunk++) {
+            roadSegments.push_back({ nextChunk * segmentSize });
+            newChunks.push_back(chunkStream ? chunkStream->Take(nextChunk) : chunkRules().Generate(nextChunk));
+        }
+    }
+
+    // Swept test: the car box is stretched over everything it covered this
+    // tick, so a fast car cannot step over an obstacle between ticks.
+    void checkCollisions(float prevCarX, float prevCarZ)
+    {
+        if (!collisionsEnabled)
+            return;
+        if (collisionIndexDirty) {
+            collisionIndex.rebuild(obstacles);
+            collisionIndexDirty = false;
+        }
+
+        float minX = std::min(prevCarX, currentCarX) - CAR_HALF_EXTENTS.x;
+        float maxX = std::max(prevCarX, currentCarX) + CAR_HALF_EXTENTS.x;
+        float minZ = prevCarZ - CAR_HALF_EXTENTS.y;
+        float maxZ = carZ + CAR_HALF_EXTENTS.y;
+
+        gameOver = collisionIndex.query(lanes,
+            minX - OBSTACLE_MAX_HALF_EXTENT, maxX + OBSTACLE_MAX_HALF_EXTENT,
+            minZ - OBSTACLE_MAX_HALF_EXTENT, maxZ + OBSTACLE_MAX_HALF_EXTENT,
+            [&](int slot) {
+                glm::vec2 half = OBSTACLE_HALF_EXTENTS[obstacles.type[slot]];
+                return obstacles.x[slot] + half.x > minX && obstacles.x[slot] - half.x < maxX
+                    && obstacles.z[slot] + half.y > minZ && obstacles.z[slot] - half.y < maxZ;
+            });
+    }
+};
+
+// Accumulates variable frame time and hands it out in whole SIM_DT ticks, so
+// the simulation result doesn't depend on the frame rate.
+class FixedTimestep {
+public:
+    float dt;
+    float maxFrameTime;  // Clamp for long frames (window drag, loading) to avoid a catch-up spiral
+    float accumulator = 0.0f;
+
+    FixedTimestep(float dt = SIM_DT, float maxFrameTime = 0.25f) : dt(dt), maxFrameTime(maxFrameTime) {}
+
+    // Returns the number of ticks to run for this frame
+    int advance(float frameTime)
+    {
+        if (frameTime > maxFrameTime) frameTime = maxFrameTime;
+        if (frameTime < 0.0f) frameTime = 0.0f;
+        accumulator += frameTime;
+        int ticks = 0;
+        while (accumulator >= dt) {
+            accumulator -= dt;
+            ticks++;
+        }
+        return ticks;
+    }
+
+    // Fraction of a tick left in the accumulator, for render interpolation
+    float alpha() const { return accumulator / dt; }
+
+    void reset() { accumulator = 0.0f; }
+};
+
+#endif